@@ -23,40 +23,12 @@
 #include <QMainWindow>
 #include <QMenuBar>
 #include <QtDebug>
-#include <QShortcut>
-#include <QEvent>
 using namespace Gui;
 
 // Wir verwenden nicht direkt UiFunction selber als Shortcut, da diese mit setEnabled(false) gleich
 // auch den Shortcut deaktiviert und wir somit bei Betätigung des Shortcut nicht mehr prüfen können,
 // ob der Befehl verfügbar ist, sobald das Item einmal als deaktiviert erkannt wurde.
-class AutoMenuShortcut : public QShortcut
-{
-public:
-    // Eigentlich ist QShortcut nicht darauf angewiesen, dass parent ein QWidget ist.
-    // parentWidget wird im Code nur einmal verwendet und nur um auf Null zu testen.
-    AutoMenuShortcut( QWidget* w, UiFunction* item, const QKeySequence& key ):
-        QShortcut( w ),d_item(item)
-    {
-        connect( item, SIGNAL(destroyed()), this, SLOT(deleteLater() ) );
-        setContext( Qt::WidgetWithChildrenShortcut  );
-        setKey( key );
-    }
-    bool event(QEvent *e)
-    {
-        // QShortcut wird vom System über diesen Event benachtrichtigt und ruft dann
-        // triggered auf.
-        if( e->type() == QEvent::Shortcut )
-        {
-            d_item->prepare();
-            if( d_item->isEnabled() )
-                d_item->execute();
-            return true;
-        }else
-            return QShortcut::event( e );
-    }
-    UiFunction* d_item;
-};
+// Die Shortcuts werden im ShortcutDispatcher des Fensters registriert.
 
 AutoMenu::AutoMenu(QWidget *parent, bool context)
     : QMenu(parent), d_noPopup(false)
@@ -89,6 +61,8 @@ AutoMenu::AutoMenu(const QString& title, QWidget *parent, bool addMenuBar)
 
 void AutoMenu::onShow()
 {
+    if( !d_anchors.isEmpty() )
+        realize();
 	// Gehe durch alle Actions und löse einen Update-Cycle aus
 	QList<QAction*> l = actions();
 	foreach( QAction* a, l )
@@ -141,11 +115,11 @@ static void _setShortCut( UiFunction* f, const QKeySequence & s, bool createShor
     f->setShortcut( s ); // Damit Shortcut in jedem Fall im Menü angezeigt wird.
     if( !s.isEmpty() && createShortcut )
     {
-        f->setShortcutContext( Qt::WidgetShortcut  );   // damit keine Mehrdeutigkeit mit AutoMenuShortcut
+        f->setShortcutContext( Qt::WidgetShortcut  );   // damit keine Mehrdeutigkeit mit ShortcutDispatcher
 
         QWidget* parent = _climbToNonMenu( f->parent() );
         if( parent )
-            new AutoMenuShortcut( parent, f, s );
+            ShortcutDispatcher::get( parent )->add( s, parent, f );
         else
             qWarning() << "AutoMenu::addCommand cannot create shortcut" << f->text() << s.toString();
     }
@@ -158,7 +132,7 @@ QAction* AutoMenu::addAutoCommand( const QString& text, const char* member,
     UiFunction* a = new NamedFunction( text, member, this );
 	addAction( a );
     _setShortCut( a, s, addAutoShortcut || d_noPopup );
-    // nur bei Popups soll es möglich sein, dass kein AutoMenuShortcut erzeugt wird.
+    // nur bei Popups soll es möglich sein, dass kein Shortcut registriert wird.
 	return a;
 }
 
@@ -171,5 +145,84 @@ QAction* AutoMenu::addCommand( const QString& text, QObject* receiver, const cha
     return a;
 }
 
+void AutoMenu::addCommands( const Command* cmds, QObject* receiver )
+{
+    Q_ASSERT( cmds != 0 );
+    // Nur ein unsichtbarer Platzhalter pro Tabelle, damit die Reihenfolge gegenüber später
+    // hinzugefügten Einträgen erhalten bleibt.
+    // RISK: ein Menü, das nur aus Platzhaltern besteht, muss von Qt trotzdem geöffnet werden
+    QAction* anchor = new QAction( this );
+    anchor->setVisible( false );
+    addAction( anchor );
+    d_anchors.append( anchor );
+
+    QWidget* host = 0;
+    for( const Command* c = cmds; c->d_text != 0; c++ )
+    {
+        Pending p;
+        p.d_cmd = c;
+        p.d_receiver = receiver;
+        p.d_hasReceiver = receiver != 0;
+        p.d_anchor = anchor;
+        p.d_f = 0;
+        p.d_shortcut = c->d_key != 0 && *c->d_text != 0 && ( c->d_autoShortcut || d_noPopup );
+        d_pending.append( p );
+        if( p.d_shortcut )
+        {
+            if( host == 0 )
+                host = _climbToNonMenu( this );
+            if( host )
+                ShortcutDispatcher::get( host )->add( QKeySequence( c->d_key ), host, this, this,
+                                                      d_pending.size() - 1 );
+            else
+                qWarning() << "AutoMenu::addCommands cannot create shortcut" << c->d_text << c->d_key;
+        }
+    }
+}
 
+void AutoMenu::realize()
+{
+    if( d_anchors.isEmpty() )
+        return;
+    for( int i = 0; i < d_pending.size(); i++ )
+    {
+        Pending& p = d_pending[i];
+        if( p.d_anchor == 0 )
+            continue; // bereits erzeugt
+        const Command* c = p.d_cmd;
+        if( *c->d_text == 0 )
+            insertSeparator( p.d_anchor );
+        else if( p.d_hasReceiver && p.d_receiver.isNull() )
+            qWarning() << "AutoMenu::realize receiver of" << c->d_text << "was deleted";
+        else
+        {
+            const QString text = QString::fromUtf8( c->d_text );
+            if( p.d_receiver )
+                p.d_f = new UiFunction( text, this, p.d_receiver, c->d_member );
+            else
+                p.d_f = new NamedFunction( text, c->d_member, this );
+            insertAction( p.d_anchor, p.d_f );
+            if( c->d_key )
+                p.d_f->setShortcut( QKeySequence( c->d_key ) );
+            if( p.d_shortcut )
+                p.d_f->setShortcutContext( Qt::WidgetShortcut );
+        }
+        p.d_anchor = 0;
+    }
+    foreach( QAction* a, d_anchors )
+        delete a;
+    d_anchors.clear();
+}
 
+UiFunction* AutoMenu::provide(int cookie)
+{
+    return realize( cookie );
+}
+
+UiFunction* AutoMenu::realize(int pending)
+{
+    if( pending < 0 || pending >= d_pending.size() )
+        return 0;
+    realize();
+    return d_pending[pending].d_f;
+}
@@ -22,14 +22,27 @@
 #define AUTOMENU_H
 
 #include <QMenu>
+#include <QList>
+#include <QPointer>
 #include <GuiTools/UiFunction.h>
+#include <GuiTools/ShortcutDispatcher.h>
 
 namespace Gui
 {
-	class AutoMenu : public QMenu
+	class AutoMenu : public QMenu, private ShortcutDispatcher::Provider
 	{
 		Q_OBJECT
 	public:
+        // Deklarative Beschreibung eines Menüeintrags für addCommands(). Die Tabelle wird mit
+        // d_text == 0 abgeschlossen; ein leerer d_text erzeugt einen Separator.
+        struct Command
+        {
+            const char* d_text;
+            const char* d_member;   // SLOT(...)
+            const char* d_key;      // 0 oder z.B. "CTRL+Z"
+            bool d_autoShortcut;
+        };
+
 		AutoMenu(QWidget *parent, bool context = false);
         AutoMenu(const QString& title, QWidget *parent = 0, bool addMenuBar = true);
 
@@ -42,10 +55,32 @@ namespace Gui
         // Receiver wird automatisch gesucht
 		QAction* addAutoCommand( const QString& text, const char* member,
                                  const QKeySequence & = 0, bool addAutoShortcut = false );
+        // Die Einträge werden erst beim ersten aboutToShow() bzw. beim ersten Shortcut erzeugt.
+        // Ist receiver == 0, wird der Receiver wie bei addAutoCommand automatisch gesucht.
+        // Die Tabelle muss so lange leben wie das Menü (typischerweise static const).
+        void addCommands( const Command*, QObject* receiver = 0 );
+        void realize(); // Erzeugt alle noch ausstehenden Einträge von addCommands
+        UiFunction* realize( int pending );
+        // Die Einträge von addCommands, ohne sie zu erzeugen (z.B. für CommandPalette)
+        int pendingCount() const { return d_pending.size(); }
+        const Command* pendingCommand( int i ) const { return d_pending[i].d_cmd; }
+        UiFunction* pendingFunction( int i ) const { return d_pending[i].d_f; } // 0 solange nicht erzeugt oder receiver gelöscht
 	protected slots:
 		void onShow();
 		void onContextRequest( const QPoint &);
     private:
+        UiFunction* provide( int cookie );
+        struct Pending
+        {
+            const Command* d_cmd;
+            QPointer<QObject> d_receiver;
+            bool d_hasReceiver; // false: NamedFunction sucht das Ziel selber
+            QAction* d_anchor; // Platzhalter, vor welchem der Eintrag eingefügt wird
+            UiFunction* d_f; // 0 solange nicht erzeugt
+            bool d_shortcut;
+        };
+        QList<Pending> d_pending;
+        QList<QAction*> d_anchors;
         bool d_noPopup;
 	};
 }
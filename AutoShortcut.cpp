@@ -20,18 +20,174 @@
 
 #include "AutoShortcut.h"
 #include "NamedFunction.h"
+#include "ShortcutDispatcher.h"
+#include <QWidget>
 #include <QEvent>
 using namespace Gui;
 
+// Der Dispatcher ruft execute direkt auf; activated wird darum danach hier gesendet.
+// execute kann den Shortcut löschen, darum owner als QPointer.
+static void _activated( const QPointer<QObject>& owner )
+{
+    if( owner )
+        QMetaObject::invokeMethod( owner, "activated" );
+}
+
+class _ShortcutFunction : public UiFunction
+{
+public:
+    _ShortcutFunction( AutoShortcut* s, QObject* receiver, const char* member ):
+        UiFunction( QString(), s, receiver, member ) {}
+    void execute()
+    {
+        QPointer<QObject> owner = parent();
+        UiFunction::execute();
+        _activated( owner );
+    }
+};
+
+class _NamedShortcutFunction : public NamedFunction
+{
+public:
+    _NamedShortcutFunction( AutoShortcut* s, const char* member ):NamedFunction( QString(), member, s ) {}
+    void execute()
+    {
+        QPointer<QObject> owner = parent();
+        NamedFunction::execute();
+        _activated( owner );
+    }
+};
 
+static int s_lastId = 0;
+
+// Der Key wird im ShortcutDispatcher des Fensters registriert, damit die Shortcut-Map von Qt
+// nicht mit jedem Befehl wächst; der Kontext ist wie bisher Qt::WidgetWithChildrenShortcut.
 AutoShortcut::AutoShortcut( const QKeySequence & key, QWidget * parent, QObject* receiver, const char * member ):
-	 QShortcut(key, parent, 0, 0, Qt::WidgetWithChildrenShortcut )
+	 QObject( parent ),d_context(Qt::WidgetWithChildrenShortcut),d_id(0),d_enabled(true),d_autoRepeat(true)
+{
+    init( key, new _ShortcutFunction( this, receiver, member ) );
+}
+
+void AutoShortcut::init(const QKeySequence& key, UiFunction* f)
+{
+    Q_ASSERT( parent() != 0 );
+    d_f = f;
+    d_key = key;
+    registerKey();
+}
+
+QWidget* AutoShortcut::host() const
+{
+    if( d_context == Qt::WidgetShortcut || d_context == Qt::WidgetWithChildrenShortcut )
+        return parentWidget();
+    else
+        return parentWidget()->window();
+}
+
+void AutoShortcut::registerKey()
+{
+    // Ein Reparent von host oder einem Vorfahren kann das Fenster und damit den Dispatcher wechseln
+    foreach( QPointer<QWidget> w, d_watched )
+    {
+        if( w )
+            w->removeEventFilter( this );
+    }
+    d_watched.clear();
+    for( QWidget* w = parentWidget(); w != 0; w = w->parentWidget() )
+    {
+        w->installEventFilter( this );
+        d_watched.append( w );
+        if( w->isWindow() )
+            break;
+    }
+    if( !d_enabled || d_key.isEmpty() )
+        return;
+    QWidget* h = host();
+    d_dispatcher = ShortcutDispatcher::get( h );
+    d_dispatcher->add( d_key, h, d_f, d_autoRepeat );
+    d_id = ++s_lastId;
+}
+
+void AutoShortcut::unregisterKey()
+{
+    if( d_dispatcher )
+        d_dispatcher->remove( d_key, d_f );
+    d_dispatcher = 0;
+    d_id = 0;
+}
+
+bool AutoShortcut::eventFilter(QObject* o, QEvent* e)
+{
+    if( e->type() == QEvent::ParentChange )
+    {
+        unregisterKey();
+        registerKey();
+    }
+    return QObject::eventFilter( o, e );
+}
+
+void AutoShortcut::setKey(const QKeySequence& key)
+{
+    unregisterKey();
+    d_key = key;
+    registerKey();
+}
+
+void AutoShortcut::setText(const QString& text)
 {
-    d_f = new UiFunction( QString(), this, receiver, member );
+    d_f->setText( text );
+}
+
+QString AutoShortcut::text() const
+{
+    return d_f->text();
+}
+
+void AutoShortcut::setEnabled(bool on)
+{
+    if( on == d_enabled )
+        return;
+    unregisterKey();
+    d_enabled = on;
+    registerKey();
+}
+
+void AutoShortcut::setContext(Qt::ShortcutContext c)
+{
+    if( c == d_context )
+        return;
+    unregisterKey();
+    d_context = c;
+    registerKey();
+}
+
+void AutoShortcut::setAutoRepeat(bool on)
+{
+    if( on == d_autoRepeat )
+        return;
+    unregisterKey();
+    d_autoRepeat = on;
+    registerKey();
+}
+
+void AutoShortcut::setWhatsThis(const QString& text)
+{
+    d_f->setWhatsThis( text );
+}
+
+QString AutoShortcut::whatsThis() const
+{
+    return d_f->whatsThis();
+}
+
+int AutoShortcut::id() const
+{
+    return d_id;
 }
 
 AutoShortcut::~AutoShortcut()
 {
+    unregisterKey();
     delete d_f;
 }
 
@@ -42,26 +198,14 @@ void AutoShortcut::onActivated()
         d_f->execute();
 }
 
-bool AutoShortcut::event(QEvent *e)
-{
-    // QShortcut wird vom System über diesen Event benachtrichtigt und ruft dann
-    // triggered auf.
-    if( e->type() == QEvent::Shortcut )
-    {
-        onActivated();
-        return true;
-    }else
-        return QShortcut::event( e );
-}
-
 AutoShortcut::AutoShortcut( QWidget * parent, const char * member, const QKeySequence & key )
-	:QShortcut(key, parent,0,0, Qt::WidgetWithChildrenShortcut )
+	:QObject( parent ),d_context(Qt::WidgetWithChildrenShortcut),d_id(0),d_enabled(true),d_autoRepeat(true)
 {
-	d_f = new NamedFunction( QString(), member, this );
+	init( key, new _NamedShortcutFunction( this, member ) );
 }
 
 AutoShortcut::AutoShortcut(const QKeySequence &key, QWidget *parent, const char *member)
-	:QShortcut(key, parent,0,0, Qt::WidgetWithChildrenShortcut )
+	:QObject( parent ),d_context(Qt::WidgetWithChildrenShortcut),d_id(0),d_enabled(true),d_autoRepeat(true)
 {
-	d_f = new NamedFunction( QString(), member, this );
+	init( key, new _NamedShortcutFunction( this, member ) );
 }
@@ -21,32 +21,63 @@
 #ifndef _Gui2_AutoShortcut
 #define _Gui2_AutoShortcut
 
-#include <QShortcut>
+#include <QObject>
+#include <QKeySequence>
+#include <QPointer>
+#include <QList>
 #include <GuiTools/UiFunction.h>
 
 namespace Gui
 {
 	class UiFunction;
+	class ShortcutDispatcher;
 
-	class AutoShortcut : public QShortcut
+	// Der Key wird im ShortcutDispatcher des Fensters registriert statt in der Shortcut-Map von Qt;
+	// darum ist AutoShortcut kein QShortcut mehr, bildet dessen Schnittstelle aber nach.
+	// ApplicationShortcut wirkt wie WindowShortcut, activatedAmbiguously wird nie gesendet.
+	class AutoShortcut : public QObject
 	{
 		Q_OBJECT
 	public:
-        // Receiver wird automatisch gesucht
 		AutoShortcut( QWidget * parent, const char * member, const QKeySequence & key = QKeySequence() );
 		AutoShortcut( const QKeySequence & key, QWidget * parent, const char * member );
-
-        // Receiver wird explizit angegeben
-		AutoShortcut( const QKeySequence & key, QWidget * parent, 
-			QObject* receiver, const char * member ); // UiFunction -> receiver
-
+		AutoShortcut( const QKeySequence & key, QWidget * parent, QObject* receiver, const char * member );
         ~AutoShortcut();
+        QKeySequence key() const { return d_key; }
+        void setKey( const QKeySequence& );
+        void setEnabled( bool );
+        bool isEnabled() const { return d_enabled; }
+        void setContext( Qt::ShortcutContext );
+        Qt::ShortcutContext context() const { return d_context; }
+        void setAutoRepeat( bool );
+        bool autoRepeat() const { return d_autoRepeat; }
+        void setWhatsThis( const QString& );
+        QString whatsThis() const;
+        int id() const; // 0 wenn nicht registriert
+        QWidget* parentWidget() const { return static_cast<QWidget*>( parent() ); }
+        // Ohne Text erscheint der Shortcut nicht in der CommandPalette
+        void setText( const QString& );
+        QString text() const;
+	signals:
+		void activated();
+		void activatedAmbiguously();
 	protected slots:
 		void onActivated();
-    protected:
-        bool event(QEvent *e);
+	protected:
+		bool eventFilter( QObject*, QEvent* );
 	private:
+		void init( const QKeySequence&, UiFunction* );
+		void registerKey();
+		void unregisterKey();
+		QWidget* host() const;
 		UiFunction* d_f;
+		QKeySequence d_key;
+		QPointer<ShortcutDispatcher> d_dispatcher; // bei dem d_key registriert ist
+		QList< QPointer<QWidget> > d_watched; // host und Vorfahren bis zum Fenster
+		Qt::ShortcutContext d_context;
+		int d_id;
+		bool d_enabled;
+		bool d_autoRepeat;
 	};
 }
 
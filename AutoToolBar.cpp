@@ -20,32 +20,108 @@
 
 #include "AutoToolBar.h"
 #include <QApplication>
+#include <QEvent>
 #include "NamedFunction.h"
 using namespace Gui;
 
+bool AutoToolBar::s_suspended = false;
+static QList<AutoToolBar*> s_all;
+
 AutoToolBar::AutoToolBar(QWidget *parent)
 	: QToolBar(parent)
 {
-   d_updater.start(QApplication::cursorFlashTime() / 2.0, this ); // RISK
+    s_all.append( this );
+    // Der Timer läuft nur, solange die Toolbar sichtbar und ihr Fenster aktiv und nicht minimiert ist.
+    watchWindow();
+    updateTimer();
 }
 
 AutoToolBar::~AutoToolBar()
 {
+    s_all.removeAll( this );
 	d_updater.stop();
 }
 
+void AutoToolBar::setUpdatesSuspended(bool on)
+{
+    if( s_suspended == on )
+        return;
+    s_suspended = on;
+    foreach( AutoToolBar* t, s_all )
+        t->updateTimer();
+}
+
+void AutoToolBar::prepareAll()
+{
+    // Gehe durch alle Actions und löse einen Update-Cycle aus
+    QList<QAction*> l = actions();
+    foreach( QAction* a, l )
+    {
+        if( UiFunction* f = dynamic_cast<UiFunction*>( a ) )
+            f->prepare();
+    }
+}
+
+void AutoToolBar::updateTimer()
+{
+    QWidget* w = window();
+    const bool run = !s_suspended && isVisible() && isActiveWindow() && !w->isMinimized();
+    if( run && !d_updater.isActive() )
+    {
+        d_updater.start(QApplication::cursorFlashTime() / 2.0, this ); // RISK
+        prepareAll(); // nachholen, was während der Pause verpasst wurde
+    }else if( !run && d_updater.isActive() )
+        d_updater.stop();
+}
+
+void AutoToolBar::watchWindow()
+{
+    // Ein Minimieren wird nur dem Fenster selber gemeldet
+    QWidget* w = window();
+    if( d_window == w )
+        return;
+    if( d_window && d_window != this )
+        d_window->removeEventFilter( this );
+    d_window = w;
+    if( w != this )
+        w->installEventFilter( this );
+}
+
 void AutoToolBar::timerEvent(QTimerEvent *e)
 { 
     if( e->timerId() == d_updater.timerId() ) 
-	{
-		// Gehe durch alle Actions und löse einen Update-Cycle aus
-		QList<QAction*> l = actions();
-		foreach( QAction* a, l )
-		{
-			if( UiFunction* f = dynamic_cast<UiFunction*>( a ) )
-				f->prepare();
-		}
-   }
+        prepareAll();
+    else
+        QToolBar::timerEvent( e );
+}
+
+bool AutoToolBar::event(QEvent *e)
+{
+    const bool res = QToolBar::event( e );
+    switch( e->type() )
+    {
+    case QEvent::ParentChange: // auch beim Andocken bzw. Abdocken
+        watchWindow();
+        updateTimer();
+        break;
+    case QEvent::Show:
+    case QEvent::Hide:
+    case QEvent::WindowActivate:
+    case QEvent::WindowDeactivate:
+    case QEvent::WindowStateChange:
+        updateTimer();
+        break;
+    default:
+        break;
+    }
+    return res;
+}
+
+bool AutoToolBar::eventFilter(QObject *watched, QEvent *e)
+{
+    if( watched == d_window && e->type() == QEvent::WindowStateChange )
+        updateTimer();
+    return QToolBar::eventFilter( watched, e );
 }
 
 QAction* AutoToolBar::addCommand( const QString& text, QObject* receiver, const char* member, const QKeySequence & s )
@@ -23,6 +23,7 @@
 
 #include <QToolBar>
 #include <QBasicTimer>
+#include <QPointer>
 #include <GuiTools/UiFunction.h>
 
 namespace Gui
@@ -41,10 +42,21 @@ namespace Gui
                                  const QKeySequence & = 0 ); // receiver wird gesucht
         QAction* addAutoCommand( const QIcon&, const QString& text, const char* member,
                                  const QKeySequence & = 0 ); // receiver wird gesucht
+
+        // Hält die Aktualisierung aller AutoToolBars an, z.B. während eines Batch-Jobs
+        static void setUpdatesSuspended( bool );
+        static bool updatesSuspended() { return s_suspended; }
+        void prepareAll(); // Löst sofort einen Update-Cycle aus
 	protected:
 		void timerEvent(QTimerEvent *e);
+        bool event(QEvent *e);
+        bool eventFilter(QObject *watched, QEvent *e);
+        void updateTimer();
+        void watchWindow();
 	private:
 		QBasicTimer d_updater;
+        QPointer<QWidget> d_window;
+        static bool s_suspended;
 	};
 }
 
@@ -19,6 +19,7 @@
 
 #include "CodeEditor.h"
 #include <GuiTools/AutoMenu.h>
+#include <GuiTools/CommandMacro.h>
 #include <QPainter>
 #include <QtDebug>
 #include <QFile>
@@ -37,6 +38,8 @@
 #include <QFontDialog>
 #include <QShortcut>
 #include <QTextBlock>
+#include <QKeyEvent>
+#include <QDataStream>
 #include <QMessageBox>
 
 // adaptiert aus AdaViewer::AdaEditor
@@ -174,7 +177,7 @@ private:
 CodeEditor::CodeEditor(QWidget *parent) :
 	QPlainTextEdit(parent), d_showNumbers(true),
     d_undoAvail(false),d_redoAvail(false),d_copyAvail(false),d_curPos(-1),
-    d_pushBackLock(false), d_noEditLock(false), d_linkLineNr(0), d_linkColNr(0),d_paintIndents(true)
+    d_pushBackLock(false), d_noEditLock(false), d_batchLock(false), d_linkLineNr(0), d_linkColNr(0),d_paintIndents(true)
 {
     d_charPerTab = s_charPerTab;
     d_typingLatencyMs = s_typingLatencyMs;
@@ -270,6 +273,8 @@ void CodeEditor::setCursorPosition(int line, int col, bool center )
             centerCursor();
         else
             ensureCursorVisible();
+        if( d_batchLock )
+            return;
         updateExtraSelections();
         onUpdateLocation();
     }
@@ -380,6 +385,8 @@ void CodeEditor::updateLineNumberArea(const QRect &rect, int dy)
 
 void CodeEditor::onUpdateCursor()
 {
+    if( d_batchLock )
+        return;
     d_cursorLatency.start(s_cursorLatencyMs);
 }
 
@@ -397,6 +404,8 @@ void CodeEditor::onUpdateModel()
 
 void CodeEditor::onUpdateLocation()
 {
+    if( d_batchLock )
+        return;
     int line, col;
     getCursorPosition( &line, &col );
     pushLocation(Location(line,col));
@@ -739,6 +748,8 @@ bool CodeEditor::viewportEvent( QEvent * event )
 
 void CodeEditor::keyPressEvent(QKeyEvent *e)
 {
+    if( !d_batchLock && Gui::CommandMacro::isRecording() )
+        Gui::CommandMacro::recordKey( e );
     // NOTE: Qt macht aus SHIFT+TAB automatisch BackTab und versendet das!
     if( e->key() == Qt::Key_Tab )
     {
@@ -913,6 +924,8 @@ void CodeEditor::setPaintIndents(bool on)
 
 void CodeEditor::highlightCurrentLine()
 {
+    if( d_batchLock )
+        return;
     updateExtraSelections();
 }
 
@@ -1143,6 +1156,148 @@ void CodeEditor::clearBreakPoints()
     d_numberArea->update();
 }
 
+static const quint8 s_stateVersion = 2; // 2: mit d_backHisto und d_forwardHisto
+
+QByteArray CodeEditor::saveState() const
+{
+    QByteArray res;
+    QDataStream out( &res, QIODevice::WriteOnly );
+    out.setVersion( QDataStream::Qt_4_6 );
+    out << s_stateVersion << d_path;
+    out << qint32( textCursor().anchor() ) << qint32( textCursor().position() );
+    out << qint32( verticalScrollBar()->value() ) << qint32( horizontalScrollBar()->value() );
+    out << d_breakPoints;
+    out << quint32( d_backHisto.size() );
+    for( int i = 0; i < d_backHisto.size(); i++ )
+        out << qint32( d_backHisto[i].d_line ) << qint32( d_backHisto[i].d_col );
+    out << quint32( d_forwardHisto.size() );
+    for( int i = 0; i < d_forwardHisto.size(); i++ )
+        out << qint32( d_forwardHisto[i].d_line ) << qint32( d_forwardHisto[i].d_col );
+    return res;
+}
+
+QString CodeEditor::pathOfState(const QByteArray& state)
+{
+    QDataStream in( state );
+    in.setVersion( QDataStream::Qt_4_6 );
+    quint8 version;
+    QString path;
+    in >> version;
+    if( version == 0 || version > s_stateVersion )
+        return QString();
+    in >> path;
+    return path;
+}
+
+bool CodeEditor::restoreState(const QByteArray& state)
+{
+    QDataStream in( state );
+    in.setVersion( QDataStream::Qt_4_6 );
+    quint8 version;
+    in >> version;
+    if( version == 0 || version > s_stateVersion )
+        return false;
+    QString path;
+    qint32 anchor, pos, vscroll, hscroll;
+    QSet<quint32> breakPoints;
+    in >> path >> anchor >> pos >> vscroll >> hscroll >> breakPoints;
+    QList<Location> histo[2];
+    for( int h = 0; h < 2 && version >= 2; h++ )
+    {
+        quint32 n = 0;
+        in >> n;
+        for( quint32 i = 0; i < n && in.status() == QDataStream::Ok; i++ )
+        {
+            qint32 line, col;
+            in >> line >> col;
+            histo[h].append( Location( line, col ) );
+        }
+    }
+    if( in.status() != QDataStream::Ok )
+        return false;
+    if( d_path.isEmpty() )
+        d_path = path;
+    // Der Text kann sich seit dem Sichern auf der Platte geaendert haben
+    const int max = qMax( document()->characterCount() - 1, 0 );
+    QTextCursor cur = textCursor();
+    cur.setPosition( qBound( 0, int(anchor), max ) );
+    cur.setPosition( qBound( 0, int(pos), max ), QTextCursor::KeepAnchor );
+    setTextCursor( cur );
+    verticalScrollBar()->setValue( vscroll );
+    horizontalScrollBar()->setValue( hscroll );
+    d_breakPoints = breakPoints;
+    if( version >= 2 )
+    {
+        // nach setTextCursor, damit die gesicherte Navigation nicht ueberschrieben wird
+        d_backHisto = histo[0];
+        d_forwardHisto = histo[1];
+    }
+    d_numberArea->update();
+    return true;
+}
+
+void CodeEditor::handleRecordMacro()
+{
+    CHECKED_IF( !d_batchLock, Gui::CommandMacro::isRecording() );
+    if( Gui::CommandMacro::isRecording() )
+        Gui::CommandMacro::stopRecording();
+    else
+        Gui::CommandMacro::startRecording();
+}
+
+void CodeEditor::handleReplayMacro()
+{
+    // d_batchLock verhindert, dass ein aufgezeichnetes Replay sich selber rekursiv aufruft
+    ENABLED_IF( !isReadOnly() && !d_batchLock && !Gui::CommandMacro::isRecording() &&
+                !Gui::CommandMacro::last().isEmpty() );
+    bool ok;
+    const int times = QInputDialog::getInt( this, tr("Replay Macro"), tr("Number of times:"), 1, 1, 1000000, 1, &ok );
+    if( !ok )
+        return;
+    replayMacro( Gui::CommandMacro::last(), times );
+}
+
+void CodeEditor::replayMacro(const Gui::CommandMacro& m, int times)
+{
+    if( m.isEmpty() || times <= 0 || d_batchLock )
+        return;
+    const QList<Gui::CommandMacro::Step> steps = m.steps(); // Kopie, falls m waehrenddessen aendert
+
+    QTextCursor block = textCursor();
+    block.beginEditBlock(); // ein einziger Undo-Schritt fuer alle Wiederholungen
+    setUpdatesEnabled( false );
+    d_noEditLock = true; // kein Neustart von d_typingLatency pro Aenderung
+    d_batchLock = true; // keine ExtraSelections, kein sigUpdateLocation pro Cursorbewegung
+
+    for( int n = 0; n < times; n++ )
+    {
+        foreach( const Gui::CommandMacro::Step& s, steps )
+        {
+            if( !s.d_f.isNull() )
+            {
+                // Wie bei einem Shortcut; das Ziel einer NamedFunction ist dieser Editor
+                s.d_f->prepareFor( this );
+                if( s.d_f->isEnabled() )
+                    s.d_f->execute();
+            }else if( s.d_key != 0 || !s.d_text.isEmpty() )
+            {
+                QKeyEvent e( QEvent::KeyPress, s.d_key, Qt::KeyboardModifiers( s.d_modifiers ), s.d_text );
+                keyPressEvent( &e );
+            }
+        }
+    }
+
+    d_batchLock = false;
+    d_noEditLock = false;
+    block.endEditBlock();
+    setUpdatesEnabled( true );
+    ensureCursorVisible();
+    updateExtraSelections();
+    onTextChanged();
+    onUpdateLocation();
+    viewport()->update();
+}
+
 void CodeEditor::installDefaultPopup()
 {
     Gui::AutoMenu* pop = new Gui::AutoMenu( this, true );
@@ -1167,6 +1322,9 @@ void CodeEditor::installDefaultPopup()
     pop->addCommand( "Unindent", this, SLOT(handleUnindent()) );
     pop->addCommand( "Fix Indents", this, SLOT(handleFixIndent()) );
     pop->addCommand( "Set Indentation Level...", this, SLOT(handleSetIndent()) );
+    pop->addSeparator();
+    pop->addCommand( "Record Macro", this, SLOT(handleRecordMacro()) );
+    pop->addCommand( "Replay Macro...", this, SLOT(handleReplayMacro()) );
 #ifdef QT_PRINTSUPPORT_LIB
 	pop->addSeparator();
 	pop->addCommand( "Print...", this, SLOT(handlePrint()), tr("CTRL+P"), true );
@@ -24,6 +24,11 @@
 #include <QSet>
 #include <QTimer>
 
+namespace Gui
+{
+    class CommandMacro;
+}
+
 // adaptiert aus AdaViewer::AdaEditor
 
 class CodeEditor : public QPlainTextEdit
@@ -83,6 +88,15 @@ public:
     bool toggleBreakPoint(quint32* out = 0); // current line
     void clearBreakPoints();
     const QSet<quint32>& getBreakPoints() const { return d_breakPoints; }
+
+    // Cursor, Scroll-Position, Breakpoints und Navigation, z.B. fuer DocTabWidget::saveTabState; restoreState
+    // erwartet, dass der Text bereits geladen ist (Pfad siehe pathOfState).
+    QByteArray saveState() const;
+    bool restoreState( const QByteArray& );
+    static QString pathOfState( const QByteArray& );
+
+    // Alle Schritte times mal in einem einzigen Undo-Block; Repaint, Modell- und Location-Updates erst am Schluss
+    void replayMacro( const Gui::CommandMacro&, int times = 1 );
 signals:
     void sigSyntaxUpdated();
     void sigUpdateLocation( int line, int col ); // cursor moved + latency
@@ -108,6 +122,8 @@ public slots:
     void handleSetFont();
     void handleGoBack();
     void handleGoForward();
+    void handleRecordMacro();
+    void handleReplayMacro();
 protected:
     friend class _HandleArea;
     struct Location
@@ -166,6 +182,7 @@ protected:
     bool d_copyAvail;
     bool d_showNumbers;
     bool d_noEditLock;
+    bool d_batchLock; // waehrend replayMacro
     bool d_paintIndents;
 };
 
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * GNU General Public License Usage
+ * This file may be used under the terms of the GNU General Public
+ * License (GPL) versions 2.0 or 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in
+ * the packaging of this file. Please review the following information
+ * to ensure GNU General Public Licensing requirements will be met:
+ * http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+ * http://www.gnu.org/copyleft/gpl.html.
+ */
+
+#include "CommandMacro.h"
+#include <QKeyEvent>
+using namespace Gui;
+
+CommandMacro* CommandMacro::s_recording = 0;
+
+static CommandMacro& _last()
+{
+    static CommandMacro s_last;
+    return s_last;
+}
+
+void CommandMacro::startRecording()
+{
+    if( s_recording == 0 )
+        s_recording = new CommandMacro();
+    s_recording->clear();
+}
+
+void CommandMacro::stopRecording()
+{
+    if( s_recording == 0 )
+        return;
+    // Der Befehl, der die Aufzeichnung beendet, wurde selber noch aufgezeichnet
+    if( !s_recording->d_steps.isEmpty() && UiFunction::me() != 0 &&
+            s_recording->d_steps.last().d_f == UiFunction::me() )
+        s_recording->d_steps.removeLast();
+    _last() = *s_recording;
+    delete s_recording;
+    s_recording = 0;
+}
+
+const CommandMacro& CommandMacro::last()
+{
+    return _last();
+}
+
+void CommandMacro::recordCommand(UiFunction* f)
+{
+    if( s_recording == 0 || f == 0 )
+        return;
+    Step s;
+    s.d_f = f;
+    s_recording->d_steps.append( s );
+}
+
+void CommandMacro::recordKey(QKeyEvent* e)
+{
+    if( s_recording == 0 || e == 0 )
+        return;
+    Step s;
+    s.d_key = e->key();
+    s.d_modifiers = int( e->modifiers() );
+    s.d_text = e->text();
+    s_recording->d_steps.append( s );
+}
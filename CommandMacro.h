@@ -0,0 +1,65 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * GNU General Public License Usage
+ * This file may be used under the terms of the GNU General Public
+ * License (GPL) versions 2.0 or 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in
+ * the packaging of this file. Please review the following information
+ * to ensure GNU General Public Licensing requirements will be met:
+ * http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+ * http://www.gnu.org/copyleft/gpl.html.
+ */
+
+#ifndef _Gui2_CommandMacro
+#define _Gui2_CommandMacro
+
+#include <QPointer>
+#include <QString>
+#include <QList>
+#include <GuiTools/UiFunction.h>
+
+class QKeyEvent;
+
+namespace Gui
+{
+    // Aufzeichnung von ausgeführten UiFunctions und Tastendrücken (z.B. im CodeEditor), welche
+    // anschliessend wiederholt werden kann. Es wird immer nur eine Aufzeichnung gleichzeitig geführt.
+	class CommandMacro
+	{
+	public:
+        struct Step
+        {
+            QPointer<UiFunction> d_f; // gesetzt bei einem Befehl, sonst ein Tastendruck
+            int d_key;
+            int d_modifiers;
+            QString d_text;
+            Step():d_key(0),d_modifiers(0) {}
+        };
+
+        static void startRecording();
+        static void stopRecording(); // Resultat in last()
+        static bool isRecording() { return s_recording != 0; }
+        static const CommandMacro& last();
+
+        // Werden von UiFunction::execute bzw. den Widgets aufgerufen, solange aufgezeichnet wird
+        static void recordCommand( UiFunction* );
+        static void recordKey( QKeyEvent* );
+
+        const QList<Step>& steps() const { return d_steps; }
+        bool isEmpty() const { return d_steps.isEmpty(); }
+        void clear() { d_steps.clear(); }
+	private:
+        QList<Step> d_steps;
+        static CommandMacro* s_recording;
+	};
+}
+
+#endif // _Gui2_CommandMacro
@@ -0,0 +1,299 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * GNU General Public License Usage
+ * This file may be used under the terms of the GNU General Public
+ * License (GPL) versions 2.0 or 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in
+ * the packaging of this file. Please review the following information
+ * to ensure GNU General Public Licensing requirements will be met:
+ * http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+ * http://www.gnu.org/copyleft/gpl.html.
+ */
+
+#include "CommandPalette.h"
+#include "AutoMenu.h"
+#include "ShortcutDispatcher.h"
+#include "AutoShortcut.h"
+#include <QApplication>
+#include <QKeyEvent>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QMenu>
+#include <QVBoxLayout>
+#include <algorithm>
+using namespace Gui;
+
+CommandPalette* CommandPalette::install(QWidget* window, const QKeySequence& key)
+{
+    Q_ASSERT( window != 0 );
+    CommandPalette* p = new CommandPalette( window->window() );
+    p->d_self = new UiFunction( tr("Command Palette..."), p, p, SLOT(handleShow()) );
+    ShortcutDispatcher::get( window )->add( key, window->window(), p->d_self );
+    return p;
+}
+
+CommandPalette::CommandPalette(QWidget* window):QWidget( window, Qt::Popup ),d_window(window),d_self(0)
+{
+    Q_ASSERT( window != 0 );
+    QVBoxLayout* box = new QVBoxLayout( this );
+    box->setMargin( 0 );
+    box->setSpacing( 0 );
+    d_edit = new QLineEdit( this );
+    d_edit->installEventFilter( this );
+    box->addWidget( d_edit );
+    d_list = new QListWidget( this );
+    d_list->setFrameStyle( QFrame::Box | QFrame::Plain );
+    d_list->setHorizontalScrollBarPolicy( Qt::ScrollBarAlwaysOff );
+    d_list->setFocusPolicy( Qt::NoFocus );
+    box->addWidget( d_list );
+    connect( d_edit, SIGNAL( textChanged( const QString& ) ), this, SLOT( onTextChanged( const QString& ) ) );
+    connect( d_list, SIGNAL( itemClicked( QListWidgetItem* ) ), this, SLOT( onActivated( QListWidgetItem* ) ) );
+}
+
+void CommandPalette::rebuild()
+{
+    d_entries.clear();
+    d_chars.clear();
+
+    // Menüs, Toolbars und AutoShortcuts sind alle Nachkommen des Fensters
+    QList<UiFunction*> l = d_window->findChildren<UiFunction*>();
+    d_entries.reserve( l.size() );
+    foreach( UiFunction* f, l )
+    {
+        if( f == d_self || f->isSeparator() )
+            continue;
+        QKeySequence key = f->shortcut();
+        if( AutoShortcut* s = qobject_cast<AutoShortcut*>( f->parent() ) )
+            key = s->key(); // der Key ist nur im ShortcutDispatcher registriert
+        addEntry( f, 0, -1, f->text(), qobject_cast<QMenu*>( f->parent() ), key );
+    }
+    // Die Einträge von AutoMenu::addCommands werden dafür nicht erzeugt (siehe function())
+    foreach( AutoMenu* m, d_window->findChildren<AutoMenu*>() )
+    {
+        for( int i = 0; i < m->pendingCount(); i++ )
+        {
+            const AutoMenu::Command* c = m->pendingCommand( i );
+            if( m->pendingFunction( i ) != 0 || *c->d_text == 0 )
+                continue; // bereits oben gefunden bzw. Separator
+            addEntry( 0, m, i, QString::fromUtf8( c->d_text ), m,
+                      ( c->d_key ) ? QKeySequence( c->d_key ) : QKeySequence() );
+        }
+    }
+}
+
+void CommandPalette::addEntry(UiFunction* f, AutoMenu* m, int pending, QString title, QMenu* menu,
+                              const QKeySequence& key)
+{
+    title.remove( QChar('&') );
+    if( title.endsWith( "..." ) )
+        title.chop( 3 );
+    title = title.trimmed();
+    if( title.isEmpty() )
+        return; // z.B. AutoShortcut ohne Text
+
+    Entry e;
+    e.d_f = f;
+    e.d_menu = m;
+    e.d_pending = pending;
+    e.d_off = d_chars.size();
+    e.d_len = title.size();
+    for( int i = 0; i < title.size(); i++ )
+        d_chars.append( title[i].toLower() );
+    e.d_acrOff = d_chars.size();
+    e.d_acrLen = 0;
+    for( int i = 0; i < title.size(); i++ )
+    {
+        if( title[i].isLetterOrNumber() && ( i == 0 || !title[i-1].isLetterOrNumber() ) )
+        {
+            d_chars.append( title[i].toLower() );
+            e.d_acrLen++;
+        }
+    }
+    if( menu )
+    {
+        QString mt = menu->title();
+        mt.remove( QChar('&') );
+        if( !mt.isEmpty() )
+            title = mt + ": " + title;
+    }
+    if( !key.isEmpty() )
+        title += "\t" + key.toString( QKeySequence::NativeText );
+    e.d_title = title;
+    d_entries.append( e );
+}
+
+int CommandPalette::score(const Entry& e, const QChar* pat, int len) const
+{
+    const QChar* acr = d_chars.constData() + e.d_acrOff;
+    if( len <= e.d_acrLen )
+    {
+        int i = 0;
+        while( i < len && acr[i] == pat[i] )
+            i++;
+        if( i == len )
+            return 100000 - e.d_acrLen; // Akronym-Präfix schlägt alles andere
+    }
+    // Teilfolge; Wortanfänge und zusammenhängende Treffer geben Bonus, kurze Texte gewinnen
+    const QChar* str = d_chars.constData() + e.d_off;
+    int s = 0;
+    int j = 0;
+    int last = -2;
+    for( int i = 0; i < e.d_len && j < len; i++ )
+    {
+        if( str[i] != pat[j] )
+            continue;
+        if( i == 0 || !str[i-1].isLetterOrNumber() )
+            s += 10;
+        if( last == i - 1 )
+            s += 5;
+        last = i;
+        j++;
+    }
+    if( j < len )
+        return -1;
+    return 1000 + s * 8 - e.d_len;
+}
+
+struct _Ranked
+{
+    int d_score;
+    int d_index;
+    bool operator<( const _Ranked& rhs ) const
+    {
+        return d_score > rhs.d_score || ( d_score == rhs.d_score && d_index < rhs.d_index );
+    }
+};
+
+QList<int> CommandPalette::rank(const QString& pattern, int max) const
+{
+    QVector<QChar> pat;
+    pat.reserve( pattern.size() );
+    for( int i = 0; i < pattern.size(); i++ )
+    {
+        if( !pattern[i].isSpace() )
+            pat.append( pattern[i].toLower() );
+    }
+    QVector<_Ranked> hits;
+    hits.reserve( d_entries.size() );
+    for( int i = 0; i < d_entries.size(); i++ )
+    {
+        const int s = ( pat.isEmpty() ) ? 0 : score( d_entries[i], pat.constData(), pat.size() );
+        if( s >= 0 )
+        {
+            _Ranked r;
+            r.d_score = s;
+            r.d_index = i;
+            hits.append( r );
+        }
+    }
+    const int n = qMin( max, hits.size() );
+    std::partial_sort( hits.begin(), hits.begin() + n, hits.end() );
+    QList<int> res;
+    for( int i = 0; i < n; i++ )
+        res.append( hits[i].d_index );
+    return res;
+}
+
+UiFunction* CommandPalette::function(int i)
+{
+    if( i < 0 || i >= d_entries.size() )
+        return 0;
+    Entry& e = d_entries[i];
+    if( e.d_f.isNull() && !e.d_menu.isNull() )
+        e.d_f = e.d_menu->realize( e.d_pending ); // erst, wenn der Eintrag sichtbar wird
+    return e.d_f;
+}
+
+void CommandPalette::handleShow()
+{
+    ENABLED_IF( true );
+
+    d_focus = QApplication::focusWidget();
+    rebuild();
+    d_edit->clear();
+    onTextChanged( QString() );
+
+    const QRect r = d_window->geometry();
+    resize( qMax( int( r.width() * 0.4 ), 300 ), d_edit->sizeHint().height() +
+            VisibleRows * qMax( d_list->sizeHintForRow( 0 ), fontMetrics().height() ) + 4 );
+    move( r.left() + r.width() / 2 - width() / 2, r.top() + r.height() / 5 );
+    show();
+    d_edit->setFocus();
+}
+
+void CommandPalette::onTextChanged(const QString& str)
+{
+    d_list->clear();
+    const QList<int> hits = rank( str, VisibleRows );
+    foreach( int i, hits )
+    {
+        UiFunction* f = function( i );
+        if( f == 0 )
+            continue;
+        // Nur die sichtbaren Treffer werden vorbereitet, und zwar für das Widget, das vor dem
+        // Öffnen den Fokus hatte.
+        f->prepareFor( d_focus );
+        QListWidgetItem* item = new QListWidgetItem( d_entries[i].d_title, d_list );
+        item->setData( Qt::UserRole, i );
+        if( !f->isEnabled() )
+            item->setFlags( item->flags() & ~Qt::ItemIsEnabled );
+    }
+    for( int row = 0; row < d_list->count(); row++ )
+    {
+        if( d_list->item( row )->flags() & Qt::ItemIsEnabled )
+        {
+            d_list->setCurrentRow( row );
+            break;
+        }
+    }
+}
+
+void CommandPalette::onActivated(QListWidgetItem* item)
+{
+    if( item && ( item->flags() & Qt::ItemIsEnabled ) )
+        execute( item->data( Qt::UserRole ).toInt() );
+}
+
+bool CommandPalette::eventFilter(QObject* watched, QEvent* e)
+{
+    if( watched == d_edit && e->type() == QEvent::KeyPress )
+    {
+        QKeyEvent* k = static_cast<QKeyEvent*>( e );
+        switch( k->key() )
+        {
+        case Qt::Key_Up:
+        case Qt::Key_Down:
+        case Qt::Key_PageUp:
+        case Qt::Key_PageDown:
+            QApplication::sendEvent( d_list, e );
+            return true;
+        case Qt::Key_Return:
+        case Qt::Key_Enter:
+            onActivated( d_list->currentItem() );
+            return true;
+        default:
+            break;
+        }
+    }
+    return QWidget::eventFilter( watched, e );
+}
+
+void CommandPalette::execute(int entry)
+{
+    UiFunction* f = function( entry );
+    hide(); // gibt den Fokus an d_focus zurück
+    if( f == 0 )
+        return;
+    // Wie bei einem Shortcut: prepare, damit NamedFunction das Ziel kennt, dann execute
+    f->prepareFor( d_focus );
+    if( f->isEnabled() )
+        f->execute();
+}
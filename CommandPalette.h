@@ -0,0 +1,88 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * GNU General Public License Usage
+ * This file may be used under the terms of the GNU General Public
+ * License (GPL) versions 2.0 or 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in
+ * the packaging of this file. Please review the following information
+ * to ensure GNU General Public Licensing requirements will be met:
+ * http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+ * http://www.gnu.org/copyleft/gpl.html.
+ */
+
+#ifndef _Gui2_CommandPalette
+#define _Gui2_CommandPalette
+
+#include <QWidget>
+#include <QPointer>
+#include <QVector>
+#include <QKeySequence>
+
+class QLineEdit;
+class QListWidget;
+class QListWidgetItem;
+class QMenu;
+
+namespace Gui
+{
+	class UiFunction;
+	class AutoMenu;
+
+    // Popup, in welchem alle UiFunctions des Fensters (Menüs, Toolbars, Shortcuts) per Texteingabe
+    // gesucht und ausgeführt werden können. Beim Öffnen wird ein Index mit den kleingeschriebenen Texten
+    // und Akronymen aufgebaut; pro Tastendruck werden nur die sichtbaren Treffer vorbereitet.
+    // Noch nicht erzeugte Einträge von AutoMenu::addCommands werden aus der Tabelle gelesen und erst
+    // erzeugt, wenn sie sichtbar werden. AutoShortcuts erscheinen nur, wenn sie mit setText einen
+    // Text erhalten haben.
+	class CommandPalette : public QWidget
+	{
+		Q_OBJECT
+	public:
+        enum { VisibleRows = 15 };
+        // Erzeugt die Palette für window und registriert den Shortcut im ShortcutDispatcher
+        static CommandPalette* install( QWidget* window,
+                                        const QKeySequence& = QKeySequence( "CTRL+SHIFT+A" ) );
+		explicit CommandPalette( QWidget* window );
+
+        void rebuild();
+        QList<int> rank( const QString& pattern, int max ) const; // Indizes, beste zuerst
+        UiFunction* function( int i ); // erzeugt einen ausstehenden Eintrag von AutoMenu::addCommands
+	public slots:
+        void handleShow();
+	protected slots:
+        void onTextChanged( const QString& );
+        void onActivated( QListWidgetItem* );
+	protected:
+        bool eventFilter( QObject*, QEvent* );
+        void execute( int entry );
+	private:
+        struct Entry
+        {
+            QPointer<UiFunction> d_f;
+            QPointer<AutoMenu> d_menu; // falls d_f erst noch mit AutoMenu::realize erzeugt werden muss
+            int d_pending;
+            QString d_title;
+            int d_off, d_len; // kleingeschriebener Text in d_chars
+            int d_acrOff, d_acrLen; // Anfangsbuchstaben der Wörter in d_chars
+        };
+        int score( const Entry&, const QChar* pattern, int len ) const;
+        void addEntry( UiFunction*, AutoMenu*, int pending, QString title, QMenu* menu, const QKeySequence& );
+        QVector<Entry> d_entries;
+        QVector<QChar> d_chars; // zusammenhängend, damit der Vergleich cache-freundlich bleibt
+        QPointer<QWidget> d_focus; // Fokus-Widget beim Öffnen
+        QWidget* d_window;
+        QLineEdit* d_edit;
+        QListWidget* d_list;
+        UiFunction* d_self;
+	};
+}
+
+#endif // _Gui2_CommandPalette
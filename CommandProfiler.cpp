@@ -0,0 +1,257 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * GNU General Public License Usage
+ * This file may be used under the terms of the GNU General Public
+ * License (GPL) versions 2.0 or 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in
+ * the packaging of this file. Please review the following information
+ * to ensure GNU General Public Licensing requirements will be met:
+ * http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+ * http://www.gnu.org/copyleft/gpl.html.
+ */
+
+#include "CommandProfiler.h"
+#include "UiFunction.h"
+#include <QAtomicPointer>
+#include <QCoreApplication>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QtDebug>
+using namespace Gui;
+
+static QAtomicPointer<CommandStats> s_head; // Neue Stats werden vorne eingehängt, nie entfernt
+static QByteArray s_output;
+// Nur für das erste Auflösen von UiFunction::commandKey; danach ist UiFunction::d_stats gesetzt
+static QMutex s_lock;
+static QHash<QByteArray,CommandStats*> s_index;
+
+static void _atExit()
+{
+    if( s_output == "1" )
+        CommandProfiler::dump();
+    else if( !s_output.isEmpty() )
+        CommandProfiler::writeJson( QString::fromLocal8Bit( s_output ) );
+}
+
+static bool _initEnabled()
+{
+    s_output = qgetenv( "GUITOOLS_PROFILE_COMMANDS" );
+    if( s_output == "0" )
+        s_output.clear();
+    return !s_output.isEmpty();
+}
+
+static int _initThreshold()
+{
+    bool ok;
+    const int ms = qgetenv( "GUITOOLS_PREPARE_THRESHOLD_MS" ).toInt( &ok );
+    return ( ok ) ? ms : 20;
+}
+
+bool CommandProfiler::s_enabled = _initEnabled();
+int CommandProfiler::s_threshold = _initThreshold();
+
+static inline int _load( const QAtomicInt& i )
+{
+    // funktioniert in Qt4 und Qt5
+    return const_cast<QAtomicInt&>( i ).fetchAndAddRelaxed( 0 );
+}
+
+static inline int _bucket( qint64 us )
+{
+    int b = 0;
+    while( us > 0 && b < CommandStats::BucketCount - 1 )
+    {
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+void CommandProfiler::setEnabled(bool on)
+{
+    s_enabled = on;
+}
+
+void CommandProfiler::setPrepareThreshold(int ms)
+{
+    s_threshold = ms;
+}
+
+CommandStats* CommandProfiler::statsOf(UiFunction* f)
+{
+    Q_ASSERT( f != 0 );
+    // Die Stats werden nie gelöscht; ist der Zeiger einmal gesetzt, braucht es kein Lock mehr
+    if( f->d_stats != 0 )
+        return f->d_stats;
+    QMutexLocker lock( &s_lock );
+    const QByteArray key = f->commandKey();
+    CommandStats* found = s_index.value( key );
+    if( found != 0 )
+    {
+        f->d_stats = found;
+        return found;
+    }
+    static bool s_registered = false;
+    if( !s_registered && !s_output.isEmpty() )
+    {
+        qAddPostRoutine( _atExit );
+        s_registered = true;
+    }
+    CommandStats* s = new CommandStats();
+    s->d_name = key; // die QAtomicInt sind bereits 0
+    // Die Leser laufen ev. in einem anderen Thread, darum wird atomar eingehängt
+    CommandStats* head;
+    do
+    {
+        head = s_head.fetchAndAddRelaxed( 0 );
+        s->d_next = head;
+    }while( !s_head.testAndSetOrdered( head, s ) );
+    s_index[key] = s;
+    f->d_stats = s;
+    return s;
+}
+
+void CommandProfiler::record(CommandStats* s, Phase p, qint64 us)
+{
+    Q_ASSERT( s != 0 );
+    if( us > 0x7fffffff )
+        us = 0x7fffffff;
+    s->d_count[p].fetchAndAddRelaxed( 1 );
+    s->d_buckets[p][_bucket( us )].fetchAndAddRelaxed( 1 );
+    int max;
+    do
+    {
+        max = _load( s->d_maxUs[p] );
+        if( us <= max )
+            break;
+    }while( !s->d_maxUs[p].testAndSetRelaxed( max, int(us) ) );
+
+    if( p == Prepare && s_threshold > 0 && us >= qint64(s_threshold) * 1000 )
+        qWarning() << "CommandProfiler: slow prepare of" << s->d_name.constData() << "took" << ( us / 1000 ) << "ms";
+}
+
+void CommandProfiler::reset()
+{
+    for( CommandStats* s = s_head.fetchAndAddRelaxed( 0 ); s != 0; s = s->d_next )
+    {
+        for( int p = 0; p < 2; p++ )
+        {
+            s->d_count[p].fetchAndStoreRelaxed( 0 );
+            s->d_maxUs[p].fetchAndStoreRelaxed( 0 );
+            for( int b = 0; b < CommandStats::BucketCount; b++ )
+                s->d_buckets[p][b].fetchAndStoreRelaxed( 0 );
+        }
+    }
+}
+
+static qint64 _percentile( const CommandStats* s, int p, int count, int percent )
+{
+    // Obere Grenze des Buckets, in dem das Perzentil liegt
+    const int rank = ( count * percent + 99 ) / 100;
+    int sum = 0;
+    for( int b = 0; b < CommandStats::BucketCount; b++ )
+    {
+        sum += _load( s->d_buckets[p][b] );
+        if( sum >= rank )
+            return qint64(1) << b;
+    }
+    return qint64(1) << ( CommandStats::BucketCount - 1 );
+}
+
+static QByteArray _escape( const QByteArray& str )
+{
+    QByteArray res;
+    res.reserve( str.size() );
+    for( int i = 0; i < str.size(); i++ )
+    {
+        const char c = str[i];
+        if( c == '\\' || c == '"' )
+        {
+            res += '\\';
+            res += c;
+        }else if( uchar(c) < 0x20 )
+        {
+            // JSON erlaubt keine Steuerzeichen in Strings; UTF-8 ab 0x80 bleibt unverändert
+            char buf[8];
+            qsnprintf( buf, sizeof(buf), "\\u%04x", uchar(c) );
+            res += buf;
+        }else
+            res += c;
+    }
+    return res;
+}
+
+QByteArray CommandProfiler::toJson()
+{
+    static const char* s_phase[] = { "prepare", "execute" };
+    QByteArray out = "{\"commands\":[";
+    bool first = true;
+    for( CommandStats* s = s_head.fetchAndAddRelaxed( 0 ); s != 0; s = s->d_next )
+    {
+        if( !first )
+            out += ',';
+        first = false;
+        out += "\n{\"name\":\"" + _escape( s->d_name ) + "\"";
+        for( int p = 0; p < 2; p++ )
+        {
+            const int count = _load( s->d_count[p] );
+            out += ",\"" + QByteArray( s_phase[p] ) + "\":{\"count\":" + QByteArray::number( count );
+            out += ",\"max_us\":" + QByteArray::number( _load( s->d_maxUs[p] ) );
+            if( count > 0 )
+            {
+                out += ",\"p50_us\":" + QByteArray::number( _percentile( s, p, count, 50 ) );
+                out += ",\"p99_us\":" + QByteArray::number( _percentile( s, p, count, 99 ) );
+            }
+            out += ",\"buckets\":[";
+            for( int b = 0; b < CommandStats::BucketCount; b++ )
+            {
+                if( b != 0 )
+                    out += ',';
+                out += QByteArray::number( _load( s->d_buckets[p][b] ) );
+            }
+            out += "]}";
+        }
+        out += '}';
+    }
+    out += "]}\n";
+    return out;
+}
+
+bool CommandProfiler::writeJson(const QString& path)
+{
+    QFile f( path );
+    if( !f.open( QIODevice::WriteOnly ) )
+    {
+        qWarning() << "CommandProfiler: cannot write" << path << f.errorString();
+        return false;
+    }
+    f.write( toJson() );
+    return true;
+}
+
+void CommandProfiler::dump()
+{
+    qDebug() << "CommandProfiler: count / p50 / p99 / max in microseconds";
+    for( CommandStats* s = s_head.fetchAndAddRelaxed( 0 ); s != 0; s = s->d_next )
+    {
+        const int pc = _load( s->d_count[Prepare] );
+        const int ec = _load( s->d_count[Execute] );
+        if( pc == 0 && ec == 0 )
+            continue;
+        qDebug() << s->d_name.constData()
+                 << "prepare" << pc << ( pc ? _percentile( s, Prepare, pc, 50 ) : 0 )
+                 << ( pc ? _percentile( s, Prepare, pc, 99 ) : 0 ) << _load( s->d_maxUs[Prepare] )
+                 << "execute" << ec << ( ec ? _percentile( s, Execute, ec, 50 ) : 0 )
+                 << ( ec ? _percentile( s, Execute, ec, 99 ) : 0 ) << _load( s->d_maxUs[Execute] );
+    }
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * GNU General Public License Usage
+ * This file may be used under the terms of the GNU General Public
+ * License (GPL) versions 2.0 or 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in
+ * the packaging of this file. Please review the following information
+ * to ensure GNU General Public Licensing requirements will be met:
+ * http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+ * http://www.gnu.org/copyleft/gpl.html.
+ */
+
+#ifndef _Gui2_CommandProfiler
+#define _Gui2_CommandProfiler
+
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QString>
+#include <QAtomicInt>
+
+namespace Gui
+{
+	class UiFunction;
+
+    // Histogramm eines Befehls (UiFunction::commandKey); wird beim ersten Messwert erzeugt und nie
+    // gelöscht, damit die Werte auch nach dem Löschen der UiFunctions noch ausgegeben werden können.
+    // Die Anzahl ist durch die Anzahl verschiedener Befehle begrenzt, nicht durch die der Instanzen.
+    struct CommandStats
+    {
+        enum { BucketCount = 24 }; // Bucket i zählt Dauern < 2^i Mikrosekunden
+        QByteArray d_name;
+        QAtomicInt d_count[2];
+        QAtomicInt d_maxUs[2];
+        QAtomicInt d_buckets[2][BucketCount];
+        CommandStats* d_next;
+    };
+
+    // Misst die Dauer von UiFunction::prepare und execute pro Befehl. Ausgeschaltet kostet ein Aufruf
+    // nur die Abfrage von isEnabled(). Einschalten mit setEnabled() oder mit der Umgebungsvariable
+    // GUITOOLS_PROFILE_COMMANDS; ist deren Wert "1", wird beim Beenden eine Zusammenfassung mit qDebug
+    // ausgegeben, sonst wird der Wert als Pfad der JSON-Datei verwendet.
+    // GUITOOLS_PREPARE_THRESHOLD_MS setzt die Schwelle, ab der ein prepare gemeldet wird.
+	class CommandProfiler
+	{
+	public:
+        enum Phase { Prepare, Execute };
+
+        static bool isEnabled() { return s_enabled; }
+        static void setEnabled( bool );
+        static void setPrepareThreshold( int ms ); // 0..keine Meldung
+        static int prepareThreshold() { return s_threshold; }
+
+        static CommandStats* statsOf( UiFunction* );
+        static void record( CommandStats*, Phase, qint64 usecs );
+        static void reset(); // setzt alle Zähler auf 0
+        static QByteArray toJson();
+        static bool writeJson( const QString& path );
+        static void dump(); // via qDebug
+
+        class Scope
+        {
+        public:
+            // Die UiFunction kann während execute gelöscht werden; darum merken wir uns nur die Stats.
+            Scope( UiFunction* f, Phase p ):d_stats(0),d_phase(p)
+            {
+                if( s_enabled )
+                {
+                    d_stats = statsOf( f );
+                    d_timer.start();
+                }
+            }
+            ~Scope()
+            {
+                if( d_stats )
+                    record( d_stats, d_phase, d_timer.nsecsElapsed() / 1000 );
+            }
+        private:
+            QElapsedTimer d_timer;
+            CommandStats* d_stats;
+            Phase d_phase;
+        };
+	private:
+        CommandProfiler() {}
+        static bool s_enabled;
+        static int s_threshold;
+	};
+}
+
+#endif // _Gui2_CommandProfiler
@@ -18,17 +18,61 @@
  */
 
 #include "Controller.h"
+#include "ControllerChain.h"
+#include "TickWheel.h"
+#include "LayerCompositor.h"
 #include <QKeyEvent>
 using namespace Gui;
 
 
-Controller::Controller(QWidget* view ):
-	QObject( view )
+Controller::Controller(QWidget* view, int eventMask ):
+	QObject( view ), d_compositor( 0 ), d_chain( 0 ), d_mask( eventMask ), d_pendingMove( 0 ), d_pendingWheel( 0 ),
+	d_pendingCount( 0 ), d_coalesced( 1 ), d_coalesce( false ), d_moveDone( false ), d_wheelDone( false )
 {
 	Q_ASSERT( view != 0 );
 	view->installEventFilter( this );
 }
 
+Controller::~Controller()
+{
+	if( d_chain )
+		d_chain->remove( this );
+	if( d_compositor )
+		d_compositor->removeLayer( this );
+	delete d_pendingMove;
+	delete d_pendingWheel;
+	if( TickWheel::exists() )
+		TickWheel::instance()->stopAll( this );
+}
+
+void Controller::invalidateLayer( const QRect& r )
+{
+	if( d_compositor )
+		d_compositor->invalidate( this, r );
+	else if( r.isNull() )
+		view()->update();
+	else
+		view()->update( r );
+}
+
+int Controller::startTick( int ms, bool singleShot )
+{
+	return TickWheel::instance()->start( this, ms, singleShot );
+}
+
+void Controller::stopTick( int id )
+{
+	if( TickWheel::exists() )
+		TickWheel::instance()->stop( id );
+}
+
+void Controller::setEventMask( int m )
+{
+	d_mask = m;
+	if( d_chain )
+		d_chain->rebuild();
+}
+
 void Controller::observe(QObject * o)
 {
 	o->installEventFilter( this );
@@ -39,10 +83,169 @@ void Controller::unobserve(QObject *o)
 	o->removeEventFilter( this );
 }
 
+int Controller::categoryOf( int eventType )
+{
+	switch( eventType )
+	{
+	case QEvent::MouseMove:
+	case QEvent::MouseButtonPress:
+	case QEvent::MouseButtonRelease:
+	case QEvent::MouseButtonDblClick:
+		return MouseEvents;
+	case QEvent::Wheel:
+		return WheelEvents;
+	case QEvent::KeyPress:
+	case QEvent::KeyRelease:
+	case QEvent::ShortcutOverride:
+		return KeyEvents;
+	case QEvent::InputMethod:
+		return InputMethodEvents;
+	case QEvent::FocusIn:
+	case QEvent::FocusOut:
+		return FocusEvents;
+	case QEvent::Enter:
+	case QEvent::Leave:
+		return EnterLeaveEvents;
+	case QEvent::Paint:
+		return PaintEvents;
+	case QEvent::Move:
+	case QEvent::Resize:
+		return GeometryEvents;
+	case QEvent::Show:
+	case QEvent::Hide:
+		return ShowHideEvents;
+	case QEvent::Close:
+		return CloseEvents;
+	case QEvent::Drop:
+	case QEvent::DragEnter:
+	case QEvent::DragMove:
+	case QEvent::DragLeave:
+		return DragDropEvents;
+	case QEvent::ToolBarChange:
+	case QEvent::ActivationChange:
+	case QEvent::EnabledChange:
+	case QEvent::FontChange:
+	case QEvent::StyleChange:
+	case QEvent::PaletteChange:
+	case QEvent::WindowTitleChange:
+	case QEvent::IconTextChange:
+	case QEvent::ModifiedChange:
+	case QEvent::MouseTrackingChange:
+	case QEvent::ParentChange:
+	case QEvent::WindowStateChange:
+	case QEvent::LanguageChange:
+		return ChangeEvents;
+	case QEvent::Timer:
+		return TimerEvents;
+	default:
+		return 0;
+	}
+}
+
+void Controller::setCoalescing( bool on )
+{
+	if( !on )
+		flushCoalesced();
+	d_coalesce = on;
+}
+
+bool Controller::coalesce( QEvent * event )
+{
+	// Solange der Calldown nicht konsumiert, wird synchron verteilt, damit der Filter das richtige
+	// Resultat zurckgibt und z.B. eine QAbstractScrollArea den Event weiterhin erhlt
+	if( event->type() == QEvent::MouseMove )
+	{
+		if( !d_moveDone )
+			return false;
+		if( d_pendingWheel )
+			flushCoalesced();
+		QMouseEvent* e = static_cast<QMouseEvent*>( event );
+		delete d_pendingMove;
+		d_pendingMove = new QMouseEvent( e->type(), e->pos(), e->globalPos(), 
+			e->button(), e->buttons(), e->modifiers() );
+	}else if( event->type() == QEvent::Wheel )
+	{
+		if( !d_wheelDone )
+			return false;
+		QWheelEvent* e = static_cast<QWheelEvent*>( event );
+#if QT_VERSION >= 0x050C00
+		// Begin und End der Phase bleiben eigene Events
+		if( d_pendingMove || ( d_pendingWheel && d_pendingWheel->phase() != e->phase() ) )
+			flushCoalesced();
+		QPoint angle = e->angleDelta();
+		QPoint pixel = e->pixelDelta();
+		if( d_pendingWheel )
+		{
+			angle += d_pendingWheel->angleDelta();
+			pixel += d_pendingWheel->pixelDelta();
+		}
+#if QT_VERSION >= 0x050E00
+		QWheelEvent* w = new QWheelEvent( e->position(), e->globalPosition(), pixel, angle,
+			e->buttons(), e->modifiers(), e->phase(), e->inverted(), e->source() );
+#else
+		QWheelEvent* w = new QWheelEvent( e->posF(), e->globalPosF(), pixel, angle,
+			e->buttons(), e->modifiers(), e->phase(), e->inverted(), e->source() );
+#endif
+#else
+		if( d_pendingMove || ( d_pendingWheel && d_pendingWheel->orientation() != e->orientation() ) )
+			flushCoalesced();
+		const int delta = e->delta() + ( ( d_pendingWheel ) ? d_pendingWheel->delta() : 0 );
+		QWheelEvent* w = new QWheelEvent( e->pos(), e->globalPos(), delta, 
+			e->buttons(), e->modifiers(), e->orientation() );
+#endif
+		delete d_pendingWheel;
+		d_pendingWheel = w;
+	}else
+		return false;
+	d_pendingCount++;
+	// Timer 0 luft ab, sobald die anstehenden Input-Events verarbeitet sind, also einmal pro Frame
+	if( !d_flush.isActive() )
+		d_flush.start( 0, this );
+	return true;
+}
+
+void Controller::flushCoalesced()
+{
+	d_flush.stop();
+	if( d_pendingCount == 0 )
+		return;
+	// Der Calldown kann neue Events auslsen; darum zuerst alles zurcksetzen
+	QMouseEvent* m = d_pendingMove;
+	QWheelEvent* w = d_pendingWheel;
+	d_pendingMove = 0;
+	d_pendingWheel = 0;
+	d_coalesced = d_pendingCount;
+	d_pendingCount = 0;
+	if( m )
+		d_moveDone = mouseMoveEvent( m );
+	else if( w )
+		d_wheelDone = wheelEvent( w );
+	d_coalesced = 1;
+	delete m;
+	delete w;
+}
+
+void Controller::timerEvent( QTimerEvent * e )
+{
+	if( e->timerId() == d_flush.timerId() )
+		flushCoalesced();
+	else
+		QObject::timerEvent( e );
+}
+
 bool Controller::eventFilter( QObject * watched, QEvent * event )
+{
+	if( watched != view() )
+		return false;
+	return dispatch( event );
+}
+
+bool Controller::dispatch( QEvent * event )
 {
 	QWidget* v = view();
-	if( watched != v )
+	// Schneller Ausstieg fr alles, was der Controller nicht abonniert hat (z.B. Paint und Timer
+	// auf einem beschftigten Canvas, wenn nur mousePressEvent berschrieben wurde)
+	if( ( d_mask & categoryOf( event->type() ) ) == 0 )
 		return false;
 
 	bool done = false;
@@ -63,10 +266,18 @@ bool Controller::eventFilter( QObject * watched, QEvent * event )
             break;
         }
     }
+	if( d_coalesce )
+	{
+		if( coalesce( event ) )
+			return true;
+		if( d_pendingCount )
+			flushCoalesced(); // z.B. vor Press oder Release, damit die Reihenfolge stimmt
+	}
     switch (event->type()) 
 	{
     case QEvent::MouseMove:
         done = mouseMoveEvent((QMouseEvent*)event);
+		d_moveDone = done;
         break;
 
     case QEvent::MouseButtonPress:
@@ -82,6 +293,7 @@ bool Controller::eventFilter( QObject * watched, QEvent * event )
         break;
     case QEvent::Wheel:
         done = wheelEvent((QWheelEvent*)event);
+		d_wheelDone = done;
         break;
     case QEvent::KeyPress: {
         QKeyEvent *k = (QKeyEvent *)event;
@@ -210,7 +422,7 @@ bool Controller::eventFilter( QObject * watched, QEvent * event )
 		done = tickEvent( (QTimerEvent *)event);
 		break;
     default:
-        return QObject::eventFilter(watched, event);
+        return false;
     }
     return done;
 }
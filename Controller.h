@@ -21,9 +21,16 @@
 #define _GUI2_CONTROLLER
 
 #include <QWidget>
+#include <QBasicTimer>
+
+class QPainter;
 
 namespace Gui
 {
+	class ControllerChain;
+	class TickWheel;
+	class LayerCompositor;
+
 	/// Diese Klasse dient dazu, das Event-Handling aus einem Widget auszulagern bzw.
 	/// an einen unabhngigen Controller zu delegieren, so dass Widget nicht direkt 
 	/// vererbt werden muss. Damit kann ein gewhnliches Widget als View/Controller-Host
@@ -31,7 +38,55 @@ namespace Gui
 	class Controller : public QObject
 	{
 	public:
-		Controller(QWidget* view );
+		/// Kategorien fr setEventMask(); Events einer nicht abonnierten Kategorie werden vom
+		/// eventFilter sofort durchgelassen, ohne einen Calldown aufzurufen.
+		enum EventCategory {
+			MouseEvents = 0x0001, // Press, Release, DoubleClick, Move
+			WheelEvents = 0x0002,
+			KeyEvents = 0x0004, // inkl. focusNextPrevChild
+			InputMethodEvents = 0x0008,
+			FocusEvents = 0x0010,
+			EnterLeaveEvents = 0x0020,
+			PaintEvents = 0x0040,
+			GeometryEvents = 0x0080, // Move, Resize
+			ShowHideEvents = 0x0100,
+			CloseEvents = 0x0200,
+			DragDropEvents = 0x0400,
+			ChangeEvents = 0x0800,
+			TimerEvents = 0x1000,
+			AllEvents = 0xffff
+		};
+		Controller(QWidget* view, int eventMask = AllEvents );
+		~Controller();
+
+		/// Nur die Kategorien angeben, deren Calldowns berschrieben wurden
+		void setEventMask( int m );
+		int eventMask() const { return d_mask; }
+		static int categoryOf( int eventType ); // 0 falls keine Calldown
+
+		/// Ist coalescing eingeschaltet, werden aufeinanderfolgende MouseMove zum letzten zusammengefasst
+		/// und die Deltas von Wheel aufsummiert; der Calldown wird erst aufgerufen, wenn die Event-Queue
+		/// abgearbeitet ist oder ein anderer Event (z.B. Press, Release) eintrifft, so dass die Reihenfolge
+		/// erhalten bleibt. Zusammengefasst wird nur, solange der Calldown den vorherigen Event derselben Art
+		/// konsumiert hat; sonst wird sofort verteilt und das echte Resultat an den Filter zurckgegeben.
+		/// Bei Wheel bleiben angleDelta, pixelDelta und phase erhalten (Qt >= 5.12).
+		void setCoalescing( bool on );
+		bool isCoalescing() const { return d_coalesce; }
+		void flushCoalesced(); // ruft einen ausstehenden mouseMoveEvent bzw. wheelEvent sofort auf
+		int coalescedCount() const { return d_coalesced; } // Anzahl Events im aktuellen Calldown
+
+		/// Periodischer bzw. einmaliger Aufruf von tickEvent ber den gemeinsamen TickWheel statt eines
+		/// eigenen Timers; gibt die (negative) timerId zurck, welche tickEvent erhlt.
+		int startTick( int ms, bool singleShot = false );
+		void stopTick( int id );
+
+		/// Erklrt r (bzw. alles) der eigenen Ebene als ungltig, wenn der Controller mit
+		/// LayerCompositor::addLayer registriert ist; sonst wird einfach die View aktualisiert.
+		void invalidateLayer( const QRect& r = QRect() );
+
+		/// Verteilt event an die Calldowns; true, wenn er konsumiert wurde.
+		/// Wird von eventFilter bzw. ControllerChain aufgerufen.
+		bool dispatch( QEvent * event );
 
 		//* Override von QObject
 		bool eventFilter( QObject * watched, QEvent * event );
@@ -39,6 +94,8 @@ namespace Gui
 
 		QWidget* view() const { return static_cast<QWidget*>( parent() ); }
 	protected:
+		void timerEvent( QTimerEvent* );
+		bool coalesce( QEvent* );
 		void unobserve( QObject* o );
 		void observe( QObject* );
 
@@ -68,6 +125,21 @@ namespace Gui
 		virtual bool hideEvent(QHideEvent *) { return false; }
         virtual bool changeEvent(QEvent *) { return false; }
         virtual bool tickEvent(QTimerEvent *) { return false; }
+		virtual void paintLayer(QPainter&, const QRect& ) {} // siehe LayerCompositor
+	private:
+		friend class ControllerChain;
+		friend class TickWheel;
+		friend class LayerCompositor;
+		LayerCompositor* d_compositor;
+		ControllerChain* d_chain; // gesetzt, wenn der Controller Teil einer Kette ist
+		int d_mask;
+		QBasicTimer d_flush;
+		QMouseEvent* d_pendingMove;
+		QWheelEvent* d_pendingWheel;
+		int d_pendingCount;
+		int d_coalesced;
+		bool d_coalesce;
+		bool d_moveDone, d_wheelDone; // Resultat des letzten mouseMoveEvent bzw. wheelEvent
 	};
 }
 
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License (LGPL) as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * You should have received a copy of the LGPL along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ControllerChain.h"
+#include "Controller.h"
+#include <QWidget>
+using namespace Gui;
+
+QHash<QWidget*,ControllerChain*> ControllerChain::s_chains;
+
+static inline int _index( int category )
+{
+	// category ist genau ein Bit aus Controller::EventCategory
+	int i = 0;
+	while( ( category & 1 ) == 0 )
+	{
+		category >>= 1;
+		i++;
+	}
+	return i;
+}
+
+ControllerChain* ControllerChain::get(QWidget* view)
+{
+	Q_ASSERT( view != 0 );
+	ControllerChain* c = s_chains.value( view );
+	if( c == 0 )
+		c = new ControllerChain( view );
+	return c;
+}
+
+ControllerChain::ControllerChain(QWidget* view):QObject( view ),d_view(view),d_gen(0)
+{
+	s_chains[view] = this;
+	view->installEventFilter( this );
+}
+
+ControllerChain::~ControllerChain()
+{
+	s_chains.remove( d_view );
+	for( int i = 0; i < d_controllers.size(); i++ )
+		d_controllers[i].d_c->d_chain = 0;
+}
+
+int ControllerChain::indexOf(Controller* c) const
+{
+	for( int i = 0; i < d_controllers.size(); i++ )
+		if( d_controllers[i].d_c == c )
+			return i;
+	return -1;
+}
+
+void ControllerChain::append(Controller* c, bool enabled)
+{
+	insert( d_controllers.size(), c, enabled );
+}
+
+void ControllerChain::insert(int pos, Controller* c, bool enabled)
+{
+	Q_ASSERT( c != 0 && c->view() == d_view );
+	if( c->d_chain == this )
+		return;
+	if( c->d_chain )
+		c->d_chain->remove( c );
+	d_view->removeEventFilter( c ); // die Kette verteilt nun
+	c->d_chain = this;
+	Entry e;
+	e.d_c = c;
+	e.d_on = enabled;
+	d_controllers.insert( qBound( 0, pos, d_controllers.size() ), e );
+	rebuild();
+}
+
+void ControllerChain::remove(Controller* c)
+{
+	const int i = indexOf( c );
+	if( i == -1 )
+		return;
+	d_controllers.removeAt( i );
+	c->d_chain = 0;
+	rebuild();
+}
+
+void ControllerChain::setEnabled(Controller* c, bool on)
+{
+	const int i = indexOf( c );
+	if( i == -1 || d_controllers[i].d_on == on )
+		return;
+	d_controllers[i].d_on = on;
+	rebuild();
+}
+
+bool ControllerChain::isEnabled(Controller* c) const
+{
+	const int i = indexOf( c );
+	return i != -1 && d_controllers[i].d_on;
+}
+
+void ControllerChain::rebuild()
+{
+	for( int b = 0; b < CategoryCount; b++ )
+	{
+		d_buckets[b].clear();
+		for( int i = 0; i < d_controllers.size(); i++ )
+		{
+			if( d_controllers[i].d_on && ( d_controllers[i].d_c->eventMask() & ( 1 << b ) ) )
+				d_buckets[b].append( d_controllers[i].d_c );
+		}
+	}
+	d_gen++;
+}
+
+bool ControllerChain::eventFilter( QObject * watched, QEvent * event )
+{
+	if( watched != d_view )
+		return false;
+	const int cat = Controller::categoryOf( event->type() );
+	if( cat == 0 )
+		return false;
+	// Kopie ist implizit geteilt; ein Calldown kann die Kette ändern oder Controller löschen
+	const QVector<Controller*> l = d_buckets[ _index( cat ) ];
+	const quint32 gen = d_gen;
+	for( int i = 0; i < l.size(); i++ )
+	{
+		if( l[i]->dispatch( event ) )
+			return true;
+		if( gen != d_gen )
+			break; // Kette wurde während des Calldowns geändert
+	}
+	return false;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License (LGPL) as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * You should have received a copy of the LGPL along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GUI2_CONTROLLERCHAIN
+#define _GUI2_CONTROLLERCHAIN
+
+#include <QObject>
+#include <QList>
+#include <QVector>
+#include <QHash>
+
+class QWidget;
+
+namespace Gui
+{
+	class Controller;
+
+	/// Ein einziger Event-Filter pro View, welcher die Events der Reihe nach an die Controller
+	/// verteilt. Pro Event-Kategorie wird eine Liste der aktiven Controller geführt, welche diese
+	/// abonniert haben (siehe Controller::setEventMask), so dass inaktive Controller (z.B. Werkzeug-
+	/// modi wie Pan, Zoom, Select) keine Kosten pro Event verursachen. Der erste Controller, der
+	/// einen Event konsumiert, beendet die Verteilung.
+	class ControllerChain : public QObject
+	{
+	public:
+		static ControllerChain* get( QWidget* view ); // erzeugt die Kette bei Bedarf
+
+		/// Übernimmt c in die Kette; dessen eigener Event-Filter auf der View wird entfernt.
+		void append( Controller* c, bool enabled = true );
+		void insert( int pos, Controller* c, bool enabled = true );
+		void remove( Controller* c ); // c bleibt bestehen, hat aber keinen Filter mehr
+		void setEnabled( Controller* c, bool on );
+		bool isEnabled( Controller* c ) const;
+		int count() const { return d_controllers.size(); }
+		Controller* controller( int i ) const { return d_controllers[i].d_c; }
+
+		void rebuild(); // nach Änderung von Reihenfolge, Maske oder enabled
+
+		//* Override von QObject
+		bool eventFilter( QObject * watched, QEvent * event );
+		//-
+		~ControllerChain();
+	private:
+		ControllerChain( QWidget* view );
+		int indexOf( Controller* ) const;
+		enum { CategoryCount = 13 }; // Anzahl Bits in Controller::EventCategory ohne AllEvents
+		struct Entry
+		{
+			Controller* d_c;
+			bool d_on;
+		};
+		QList<Entry> d_controllers;
+		QVector<Controller*> d_buckets[CategoryCount]; // aktive Abonnenten pro Kategorie in Reihenfolge
+		QWidget* d_view;
+		quint32 d_gen; // ändert bei jedem rebuild
+		static QHash<QWidget*,ControllerChain*> s_chains;
+	};
+}
+
+#endif // _GUI2_CONTROLLERCHAIN
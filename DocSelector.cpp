@@ -18,10 +18,13 @@
 */
 
 #include "DocSelector.h"
+#include "DocTabWidget.h"
 #include <QKeyEvent>
 #include <QtDebug>
 #include <QPainter>
 #include <QListView>
+#include <QLabel>
+#include <QStyledItemDelegate>
 #include <QVBoxLayout>
 #include <QAbstractListModel>
 #include <QDesktopWidget>
@@ -32,29 +35,319 @@
 class DocSelectorMdl : public QAbstractListModel
 {
 public:
-	DocSelectorMdl( QObject* p, const QList<QWidget*>& l ):QAbstractListModel(p),d_order(l) 
+	DocSelectorMdl( QObject* p, DocTabWidget* t ):QAbstractListModel(p),d_tabs(t)
 	{
+		const DocTabMru& mru = d_tabs->mru();
+		d_rows.reserve( mru.size() );
+		for( DocTabMru::Iterator it = mru.first(); it.isValid(); ++it )
+			d_rows.append( *it );
+		reindex( 0 );
 	}
 	~DocSelectorMdl()
 	{
 	}
-	QList<QWidget*> d_order;
+	DocTabWidget* d_tabs;
+	// Abbild von d_tabs->mru(), das bei jeder Änderung mit moveRows, insertRows etc. nachgeführt wird.
+	// Die Titel werden erst in data() geholt, damit nur die sichtbaren Zeilen etwas kosten.
+	QVector<QWidget*> d_rows;
+	QHash<QWidget*,int> d_rowOf;
 
-    int rowCount ( const QModelIndex & = QModelIndex() ) const { return d_order.size(); }
+	// Filter: Titel und Pfad werden beim ersten Zeichen einmal in Kleinbuchstaben kopiert. Für jedes
+	// weitere Zeichen wird nur die vorherige Treffermenge eingeschränkt, wobei pro Treffer die Position
+	// nach dem zuletzt gefundenen Zeichen gemerkt ist (Teilfolge, früheste Übereinstimmung).
+	struct Entry
+	{
+		QWidget* d_w;
+		QString d_title;
+		QString d_path;
+	};
+	struct Hit
+	{
+		int d_entry;
+		int d_title; // -1..passt nicht mehr
+		int d_path;
+	};
+	QVector<Entry> d_entries; // wie d_rows
+	QList< QVector<Hit> > d_levels; // d_levels[n] sind die Treffer der ersten n Zeichen
+	QString d_filter;
+
+	bool isFiltered() const { return !d_filter.isEmpty(); }
+	static int advance( const QString& str, int pos, QChar c )
+	{
+		if( pos < 0 )
+			return -1;
+		const int i = str.indexOf( c, pos );
+		return ( i < 0 ) ? -1 : i + 1;
+	}
+	void push( QChar c )
+	{
+		c = c.toLower();
+		if( d_levels.isEmpty() )
+		{
+			d_entries.resize( d_rows.size() );
+			QVector<Hit> all( d_rows.size() );
+			for( int n = 0; n < d_rows.size(); n++ )
+			{
+				const int i = d_tabs->tabOf( d_rows[n] );
+				Entry& e = d_entries[n];
+				e.d_w = d_rows[n];
+				e.d_title = d_tabs->tabText( i ).toLower();
+				e.d_path = d_tabs->getDoc( i ).toString().toLower();
+				if( e.d_path.isEmpty() )
+					e.d_path = d_tabs->tabToolTip( i ).toLower();
+				all[n].d_entry = n;
+				all[n].d_title = 0;
+				all[n].d_path = 0;
+			}
+			d_levels.append( all );
+		}
+		beginResetModel();
+		const QVector<Hit>& prev = d_levels.last();
+		QVector<Hit> next;
+		next.reserve( prev.size() );
+		for( int i = 0; i < prev.size(); i++ )
+		{
+			const Entry& e = d_entries[prev[i].d_entry];
+			Hit h;
+			h.d_entry = prev[i].d_entry;
+			h.d_title = advance( e.d_title, prev[i].d_title, c );
+			h.d_path = advance( e.d_path, prev[i].d_path, c );
+			if( h.d_title >= 0 || h.d_path >= 0 )
+				next.append( h );
+		}
+		d_levels.append( next );
+		d_filter += c;
+		endResetModel();
+	}
+	void pop()
+	{
+		if( !isFiltered() )
+			return;
+		beginResetModel();
+		d_levels.removeLast();
+		d_filter.chop( 1 );
+		if( d_filter.isEmpty() )
+			clearFilterData();
+		endResetModel();
+	}
+	void clearFilterData()
+	{
+		d_levels.clear();
+		d_entries.clear();
+		d_filter.clear();
+	}
+	void clearFilter()
+	{
+		if( !isFiltered() )
+			return;
+		beginResetModel();
+		clearFilterData();
+		endResetModel();
+	}
+	QString titleOf( QWidget* w ) const { return d_tabs->tabText( d_tabs->tabOf( w ) ); }
+	void reindex( int from, int to = -1 )
+	{
+		if( to == -1 )
+			to = d_rows.size() - 1;
+		for( int n = from; n <= to; n++ )
+			d_rowOf[ d_rows[n] ] = n;
+	}
+	// Die folgenden Änderungen setzen voraus, dass kein Filter aktiv ist (siehe DocSelector::dropFilter)
+	void touched( QWidget* w )
+	{
+		const int n = d_rowOf.value( w, -1 );
+		if( n == 0 )
+			return;
+		if( n == -1 )
+		{
+			beginInsertRows( QModelIndex(), 0, 0 );
+			d_rows.prepend( w );
+			reindex( 0 );
+			endInsertRows();
+			return;
+		}
+		beginMoveRows( QModelIndex(), n, n, QModelIndex(), 0 );
+		d_rows.remove( n );
+		d_rows.prepend( w );
+		reindex( 0, n );
+		endMoveRows();
+	}
+	void appended( QWidget* w )
+	{
+		if( d_rowOf.contains( w ) )
+			return;
+		const int n = d_rows.size();
+		beginInsertRows( QModelIndex(), n, n );
+		d_rows.append( w );
+		d_rowOf[w] = n;
+		endInsertRows();
+	}
+	void removed( QWidget* w )
+	{
+		const int n = d_rowOf.value( w, -1 );
+		if( n == -1 )
+			return;
+		beginRemoveRows( QModelIndex(), n, n );
+		d_rows.remove( n );
+		d_rowOf.remove( w );
+		reindex( n );
+		endRemoveRows();
+	}
+	void replaced( QWidget* before, QWidget* after )
+	{
+		const int n = d_rowOf.value( before, -1 );
+		if( n == -1 )
+			return;
+		d_rows[n] = after;
+		d_rowOf.remove( before );
+		d_rowOf[after] = n;
+		emit dataChanged( index( n, 0 ), index( n, 0 ) );
+	}
+	void reset() // z.B. nach DocTabWidget::closeTabs, das viele Tabs auf einmal entfernt
+	{
+		beginResetModel();
+		clearFilterData();
+		const DocTabMru& mru = d_tabs->mru();
+		d_rows.clear();
+		d_rows.reserve( mru.size() );
+		d_rowOf.clear();
+		for( DocTabMru::Iterator it = mru.first(); it.isValid(); ++it )
+			d_rows.append( *it );
+		reindex( 0 );
+		endResetModel();
+	}
+	void changed( QWidget* w )
+	{
+		const int n = d_rowOf.value( w, -1 );
+		if( n == -1 )
+			return;
+		if( !isFiltered() )
+		{
+			emit dataChanged( index( n, 0 ), index( n, 0 ) );
+			return;
+		}
+		const QVector<Hit>& hits = d_levels.last();
+		for( int i = 0; i < hits.size(); i++ )
+			if( hits[i].d_entry == n )
+				emit dataChanged( index( i, 0 ), index( i, 0 ) );
+	}
+
+	int entryAt( int row ) const // Index in d_rows
+	{
+		if( isFiltered() )
+		{
+			const QVector<Hit>& hits = d_levels.last();
+			if( row < 0 || row >= hits.size() )
+				return -1;
+			return hits[row].d_entry;
+		}
+		if( row < 0 || row >= d_rows.size() )
+			return -1;
+		return row;
+	}
+
+    int rowCount ( const QModelIndex & = QModelIndex() ) const
+	{
+		if( isFiltered() )
+			return d_levels.last().size();
+		return d_rows.size();
+	}
 	QVariant data ( const QModelIndex & index, int role = Qt::DisplayRole ) const
 	{
+		const int n = entryAt( index.row() );
+		if( n == -1 )
+			return QVariant();
+		QWidget* w = d_rows[n];
 		if( role == Qt::DisplayRole || role == Qt::ToolTipRole )
-			return d_order[ d_order.size() - 1 - index.row() ]->objectName();
-		else if( role == Qt::UserRole )
-			return QVariant::fromValue( d_order[ d_order.size() - 1 - index.row() ] );
+			return titleOf( w );
+		else if( role == Qt::DecorationRole && d_tabs->thumbnails() )
+		{
+			// nie warten; fehlt das Abbild noch, meldet es DocThumbnails::ready
+			const QPixmap p = d_tabs->thumbnails()->find( w );
+			if( p.isNull() )
+				return d_tabs->thumbnails()->placeholder();
+			return p;
+		}else if( role == Qt::UserRole )
+			return QVariant::fromValue( w );
 		return QVariant();
 	}
 };
 
+// Zeichnet den Titel selber, um die Zeichen hervorzuheben, welche zum Filter passen
+class DocSelectorDelegate : public QStyledItemDelegate
+{
+public:
+	DocSelectorDelegate( DocSelectorMdl* p ):QStyledItemDelegate(p),d_mdl(p) {}
+	DocSelectorMdl* d_mdl;
+
+	void paint( QPainter * painter, const QStyleOptionViewItem & option, const QModelIndex & index ) const
+	{
+		if( !d_mdl->isFiltered() || index.row() >= d_mdl->rowCount() ||
+				d_mdl->d_levels.last()[index.row()].d_title < 0 ) // nur der Pfad passt
+		{
+			QStyledItemDelegate::paint( painter, option, index );
+			return;
+		}
+		QStyleOptionViewItemV4 opt = option;
+		initStyleOption( &opt, index );
+		const QString text = opt.text;
+		opt.text.clear();
+		QStyle* style = ( opt.widget ) ? opt.widget->style() : QApplication::style();
+		style->drawControl( QStyle::CE_ItemViewItem, &opt, painter, opt.widget );
+
+		const QRect r = style->subElementRect( QStyle::SE_ItemViewItemText, &opt, opt.widget ).
+				adjusted( 2, 0, -2, 0 );
+		QFont bold = opt.font;
+		bold.setBold( true );
+		const QFontMetrics fm( opt.font );
+		const QFontMetrics bfm( bold );
+		painter->save();
+		painter->setClipRect( r );
+		painter->setPen( opt.palette.color( ( opt.state & QStyle::State_Selected ) ?
+												QPalette::HighlightedText : QPalette::Text ) );
+		int x = r.left();
+		const int y = r.top() + ( r.height() - fm.height() ) / 2 + fm.ascent();
+		int j = 0;
+		const QString& pat = d_mdl->d_filter;
+		for( int i = 0; i < text.size() && x < r.right(); i++ )
+		{
+			// wie bei push die früheste Übereinstimmung
+			const bool hit = j < pat.size() && text[i].toLower() == pat[j];
+			if( hit )
+				j++;
+			painter->setFont( ( hit ) ? bold : opt.font );
+			painter->drawText( x, y, QString( text[i] ) );
+			x += ( hit ) ? bfm.width( text[i] ) : fm.width( text[i] );
+		}
+		painter->restore();
+	}
+};
+
 class DocSelectorList : public QListView
 {
 public:
-	DocSelectorList( QWidget* p ):QListView(p) {}
+	DocSelectorList( QWidget* p, QLabel* l ):QListView(p),d_label(l) {}
+	QLabel* d_label;
+
+	DocSelectorMdl* mdl() const { return static_cast<DocSelectorMdl*>( model() ); }
+	static QChar filterChar( QKeyEvent* event )
+	{
+		const QString t = event->text();
+		if( t.size() == 1 && t[0].isPrint() && !t[0].isSpace() )
+			return t[0];
+		// Während Ctrl gehalten wird (Ctrl+Tab), liefert text() Steuerzeichen
+		if( ( event->modifiers() & Qt::ControlModifier ) &&
+				( ( event->key() >= Qt::Key_A && event->key() <= Qt::Key_Z ) ||
+				  ( event->key() >= Qt::Key_0 && event->key() <= Qt::Key_9 ) ) )
+			return QChar( event->key() ).toLower();
+		return QChar();
+	}
+	void filtered()
+	{
+		d_label->setText( mdl()->d_filter );
+		d_label->setVisible( mdl()->isFiltered() );
+		setCurrentIndex( model()->index( 0, 0 ) );
+	}
 	void keyPressEvent ( QKeyEvent * event )
 	{
 		//qDebug() << "Keypress";
@@ -72,8 +365,22 @@ public:
 				setCurrentIndex( model()->index( i.row() + 1, 0 ) );
 			else
 				setCurrentIndex( model()->index( 0, 0 ) );
-		}else
-			QListView::keyPressEvent( event );
+		}else if( event->key() == Qt::Key_Backspace )
+		{
+			mdl()->pop();
+			filtered();
+		}else if( event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter )
+			parentWidget()->hide();
+		else
+		{
+			const QChar c = filterChar( event );
+			if( !c.isNull() )
+			{
+				mdl()->push( c );
+				filtered();
+			}else
+				QListView::keyPressEvent( event );
+		}
 	}
 	void keyReleaseEvent ( QKeyEvent * event )
 	{
@@ -84,46 +391,110 @@ public:
 	}
 };
 
-DocSelector::DocSelector(const QList<QWidget*>& l):QWidget( 0, Qt::Popup )
+DocSelector::DocSelector(DocTabWidget* t):QWidget( t, Qt::Popup )
 {
-	d_mdl = new DocSelectorMdl( this, l );
+	d_mdl = new DocSelectorMdl( this, t );
 	QVBoxLayout* box = new QVBoxLayout( this );
 	box->setMargin(0);
-	QListView* v = new DocSelectorList( this );
+	QLabel* l = new QLabel( this );
+	l->setFrameStyle( QFrame::Box | QFrame::Plain );
+	l->hide();
+	box->addWidget( l );
+	QListView* v = new DocSelectorList( this, l );
 	d_view = v;
+	v->setItemDelegate( new DocSelectorDelegate( d_mdl ) );
 	v->setSelectionMode( QAbstractItemView::SingleSelection );
 	v->setSelectionRectVisible( true );
 	v->setFrameStyle( QFrame::Box | QFrame::Plain );
 	v->setModel( d_mdl );
-	v->setFocus();
 	v->setHorizontalScrollBarPolicy( Qt::ScrollBarAlwaysOff );
 	box->addWidget( v );
 	connect( v, SIGNAL( clicked ( const QModelIndex & ) ), this, SLOT( onClicked ( const QModelIndex & ) ) );
+}
 
-	QDesktopWidget dw;
-	QRect r = dw.screenGeometry();
+DocSelector::~DocSelector()
+{
+	//qDebug() << "Delete";
+}
+
+void DocSelector::popup()
+{
+	if( DocThumbnails* th = d_mdl->d_tabs->thumbnails() )
+	{
+		d_view->setIconSize( th->size() );
+		connect( th, SIGNAL( ready( QWidget* ) ), this, SLOT( onThumbnail( QWidget* ) ), Qt::UniqueConnection );
+	}else
+		d_view->setIconSize( QSize() );
+
+	const QRect r = QApplication::desktop()->screenGeometry( parentWidget() );
 	resize( qMax( int( r.width() * 0.2 ), 300 ), qMax( int( r.height() * 0.2 ), 200 ) );
     move( r.left() + r.width() / 2 - width() / 2, r.top() + r.height() / 2 - height() / 2 ); // ansonsten auf Linux links oben
 	show();
+	d_view->setFocus();
 
 	if( QApplication::keyboardModifiers() == Qt::ControlModifier )
 		d_view->setCurrentIndex( d_mdl->index( 1, 0 ) );
 	else if( QApplication::keyboardModifiers() == ( Qt::ControlModifier | Qt::ShiftModifier ) )
 		d_view->setCurrentIndex( d_mdl->index( d_mdl->rowCount() - 1, 0 ) );
+	else
+		d_view->setCurrentIndex( d_mdl->index( 0, 0 ) );
 }
 
-DocSelector::~DocSelector()
+void DocSelector::dropFilter()
 {
-	//qDebug() << "Delete";
+	// Ändert sich die Reihenfolge während der Anzeige (selten, z.B. wenn ein Timer einen Tab schliesst),
+	// passt die Treffermenge nicht mehr; sonst ist ohnehin kein Filter aktiv.
+	if( !d_mdl->isFiltered() )
+		return;
+	d_mdl->clearFilter();
+	static_cast<DocSelectorList*>( d_view )->filtered();
+}
+
+void DocSelector::mruTouched(QWidget* w)
+{
+	dropFilter();
+	d_mdl->touched( w );
+}
+
+void DocSelector::mruAppended(QWidget* w)
+{
+	dropFilter();
+	d_mdl->appended( w );
+}
+
+void DocSelector::mruRemoved(QWidget* w)
+{
+	dropFilter();
+	d_mdl->removed( w );
+}
+
+void DocSelector::mruReplaced(QWidget* before, QWidget* after)
+{
+	dropFilter();
+	d_mdl->replaced( before, after );
+}
+
+void DocSelector::mruReset()
+{
+	d_mdl->reset();
+	if( isVisible() )
+		static_cast<DocSelectorList*>( d_view )->filtered();
 }
 
 void DocSelector::hideEvent ( QHideEvent * event )
 {
 	QWidget::hideEvent( event );
-	deleteLater();
 	//qDebug() << "hide";
 	if( d_view->currentIndex().isValid() )
 		emit sigSelected( d_view->currentIndex().data( Qt::UserRole ).value<QWidget*>() );
+	d_mdl->clearFilter();
+	static_cast<DocSelectorList*>( d_view )->filtered();
+}
+
+void DocSelector::onThumbnail(QWidget* w)
+{
+	if( isVisible() )
+		d_mdl->changed( w );
 }
 
 void DocSelector::onClicked ( const QModelIndex & )
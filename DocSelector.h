@@ -23,27 +23,43 @@
 #include <QWidget>
 #include <QList>
 
-class QAbstractItemModel;
 class QListView;
 class QModelIndex;
+class DocTabWidget;
+class DocSelectorMdl;
 
 
 // adaptiert aus CrossLine
 
+// Wird von DocTabWidget einmal erzeugt und danach nur noch mit popup() gezeigt. Das Modell ist ein
+// Abbild der MRU-Reihenfolge, das bei jeder Änderung schrittweise nachgeführt wird; popup() muss
+// darum weder die Liste neu aufbauen noch alle Titel abfragen.
+// Tippen filtert die Liste nach Titel und Pfad (Teilfolge, Gross/Klein egal), Backspace nimmt das
+// letzte Zeichen zurück, Return oder das Loslassen von Ctrl wählt den aktuellen Eintrag.
 class DocSelector : public QWidget
 {
     Q_OBJECT
 public:
-    DocSelector(const QList<QWidget*>& );
+    DocSelector( DocTabWidget* );
     ~DocSelector();
+    void popup();
+
+    // aufgerufen von DocTabWidget bei jeder Änderung von DocTabWidget::mru()
+    void mruTouched( QWidget* );
+    void mruAppended( QWidget* );
+    void mruRemoved( QWidget* );
+    void mruReplaced( QWidget* before, QWidget* after );
+    void mruReset();
 signals:
     void sigSelected( QWidget* );
 protected:
     void hideEvent ( QHideEvent * event );
 protected slots:
     void onClicked ( const QModelIndex & index );
+    void onThumbnail( QWidget* );
 private:
-    QAbstractItemModel* d_mdl;
+    void dropFilter();
+    DocSelectorMdl* d_mdl;
     QListView* d_view;
 };
 
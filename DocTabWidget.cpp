@@ -22,14 +22,207 @@
 #include <QTabBar>
 #include <GuiTools/UiFunction.h>
 #include <QMessageBox>
+#include <QPainter>
+#include <QProgressDialog>
+#include <QApplication>
+#include <QDataStream>
+#include <QThreadPool>
 #include "DocSelector.h"
 
+void DocTabMru::unlink(Node* n)
+{
+    if( n->d_prev )
+        n->d_prev->d_next = n->d_next;
+    else
+        d_head = n->d_next;
+    if( n->d_next )
+        n->d_next->d_prev = n->d_prev;
+    else
+        d_tail = n->d_prev;
+    n->d_prev = n->d_next = 0;
+}
+
+void DocTabMru::touch(QWidget* w)
+{
+    Node* n = d_nodes.value( w );
+    if( n == d_head && n != 0 )
+    {
+        n->d_used = d_clock.elapsed();
+        return;
+    }
+    if( n )
+        unlink( n );
+    else
+    {
+        n = new Node();
+        n->d_w = w;
+        n->d_prev = n->d_next = 0;
+        d_nodes.insert( w, n );
+    }
+    n->d_used = d_clock.elapsed();
+    n->d_next = d_head;
+    if( d_head )
+        d_head->d_prev = n;
+    d_head = n;
+    if( d_tail == 0 )
+        d_tail = n;
+}
+
+void DocTabMru::append(QWidget* w)
+{
+    if( d_nodes.contains( w ) )
+        return;
+    Node* n = new Node();
+    n->d_w = w;
+    n->d_used = d_clock.elapsed();
+    n->d_next = 0;
+    n->d_prev = d_tail;
+    d_nodes.insert( w, n );
+    if( d_tail )
+        d_tail->d_next = n;
+    d_tail = n;
+    if( d_head == 0 )
+        d_head = n;
+}
+
+void DocTabMru::replace(QWidget* before, QWidget* after)
+{
+    Node* n = d_nodes.take( before );
+    if( n == 0 )
+        return;
+    n->d_w = after;
+    d_nodes.insert( after, n );
+}
+
+void DocTabMru::remove(QWidget* w)
+{
+    Node* n = d_nodes.take( w );
+    if( n == 0 )
+        return;
+    unlink( n );
+    delete n;
+}
+
+void DocTabMru::clear()
+{
+    qDeleteAll( d_nodes );
+    d_nodes.clear();
+    d_head = d_tail = 0;
+}
+
+// Factory für einen schlafenden Tab; stellt ihn mit dem gesicherten Zustand wieder her
+class _HibernatedTab : public DocTabFactory
+{
+public:
+    _HibernatedTab( DocTabWidget* t, const QByteArray& state ):d_tabs(t),d_state(state) {}
+    QWidget* create( const QVariant& doc ) { return d_tabs->restoreTab( doc, d_state ); }
+    QByteArray state() const { return d_state; }
+private:
+    DocTabWidget* d_tabs;
+    QByteArray d_state;
+};
+
+DocThumbnails::DocThumbnails(QObject* p, const QSize& size, int maxBytes):QObject(p),
+    d_cache(maxBytes),d_size(size),d_wanted(false)
+{
+    d_placeholder = QPixmap( size );
+    d_placeholder.fill( Qt::lightGray );
+    QPainter pp( &d_placeholder );
+    pp.setPen( Qt::gray );
+    pp.drawRect( 0, 0, size.width() - 1, size.height() - 1 );
+    // gedrosselt, damit Eingaben zwischen den Aufnahmen drankommen
+    d_idle.setSingleShot( true );
+    d_idle.setInterval( 50 );
+    connect( &d_idle, SIGNAL( timeout() ), this, SLOT( onIdle() ) );
+}
+
+DocThumbnails::~DocThumbnails()
+{
+}
+
+void DocThumbnails::invalidate(QWidget* w)
+{
+    if( w == 0 )
+        return;
+    d_dirty.removeOne( w );
+    d_dirty.append( w );
+    if( d_wanted && !d_idle.isActive() )
+        d_idle.start();
+}
+
+QPixmap DocThumbnails::render(QWidget* w) const
+{
+    QSize s = w->size();
+    s.scale( d_size, Qt::KeepAspectRatio );
+    if( s.isEmpty() )
+        return QPixmap();
+    // Direkt in der Zielgrösse statt grab() in voller Auflösung und danach verkleinern
+    QImage img( s, QImage::Format_RGB32 );
+    QPainter p( &img );
+    p.scale( qreal( s.width() ) / w->width(), qreal( s.height() ) / w->height() );
+    w->render( &p );
+    p.end();
+    return QPixmap::fromImage( img );
+}
+
+void DocThumbnails::onIdle()
+{
+    if( d_dirty.isEmpty() )
+        return;
+    QWidget* w = d_dirty.takeFirst();
+    const QPixmap pix = render( w );
+    if( !pix.isNull() )
+    {
+        d_cache.insert( w, new QPixmap( pix ), pix.width() * pix.height() * pix.depth() / 8 );
+        emit ready( w );
+    }
+    if( !d_dirty.isEmpty() )
+        d_idle.start();
+}
+
+QPixmap DocThumbnails::find(QWidget* w)
+{
+    if( !d_wanted )
+    {
+        d_wanted = true; // ab jetzt wird aufgenommen
+        if( !d_dirty.isEmpty() )
+            d_idle.start();
+    }
+    QPixmap* p = d_cache.object( w );
+    if( p )
+        return *p;
+    else
+        return QPixmap();
+}
+
+void DocThumbnails::rename(QWidget* before, QWidget* after)
+{
+    QPixmap* p = d_cache.take( before );
+    if( p )
+        d_cache.insert( after, p, p->width() * p->height() * p->depth() / 8 );
+    d_dirty.removeOne( before ); // after ist ein Platzhalter; das bisherige Abbild bleibt
+}
+
+void DocThumbnails::remove(QWidget* w)
+{
+    d_cache.remove( w );
+    d_dirty.removeOne( w );
+}
+
+void DocThumbnails::clear()
+{
+    d_cache.clear();
+    d_dirty.clear();
+}
+
 DocTabWidget::DocTabWidget( QWidget* p, bool hideSingleTab ):QTabWidget(p),
+	d_stale(-1),d_selector(0),d_thumbs(0),d_budget(0),d_idleSecs(0),
 	d_backLock(false),d_observed(false), d_hideSingleTab( hideSingleTab )
 {
 	setUsesScrollButtons( true );
 	setElideMode( Qt::ElideNone );
 	connect( this, SIGNAL( currentChanged ( int  ) ), this, SLOT( onTabChanged( int ) ) );
+	connect( tabBar(), SIGNAL( tabMoved( int, int ) ), this, SLOT( onTabMoved( int, int ) ) );
 	d_closer = new QToolButton( this );
 	d_closer->setEnabled(true);
 	d_closer->setIcon( QIcon( ":/MasterPlan/images/close.png" ) );
@@ -39,6 +232,12 @@ DocTabWidget::DocTabWidget( QWidget* p, bool hideSingleTab ):QTabWidget(p),
 	setCornerWidget( d_closer, Qt::TopLeftCorner );
 	if( d_hideSingleTab )
 		tabBar()->hide(); // wir beginnen zuerst ohne Tab	
+	connect( &d_hibernator, SIGNAL( timeout() ), this, SLOT( hibernateIdle() ) );
+}
+
+DocTabWidget::~DocTabWidget()
+{
+    qDeleteAll( d_lazy );
 }
 
 void DocTabWidget::setCloserIcon( const QString& path )
@@ -50,10 +249,11 @@ int DocTabWidget::addFixed( QWidget* w, const QString& title )
 {
     d_views.append( QVariant() );
 	addTab( w, title );
+	d_tabOf[w] = d_views.size() - 1;
 	const bool old = d_backLock;
 	d_backLock = true;
 	setCurrentIndex( d_views.size() - 1 );
-	d_order.append( w );
+	mruTouch( w );
 	d_backLock = old;
 	return d_views.size() - 1;
 }
@@ -66,43 +266,359 @@ int DocTabWidget::showDoc(const QVariant& doc )
 	return pos;
 }
 
+static inline uint _hashNumber( double d )
+{
+    if( d == 0.0 )
+        d = 0.0; // -0.0
+    return qHash( QByteArray::number( d, 'g', 17 ) );
+}
+
+uint DocTabWidget::hashDoc(const QVariant& doc, bool* loose)
+{
+    // Muss für gleiche Docs gleich sein; Kollisionen werden in findDoc mit == aufgelöst.
+    // QVariant::operator== konvertiert zwischen Typen (z.B. Int 1 == Double 1.0 == String "1"),
+    // darum werden Zahlen und Strings gemeinsam normalisiert. Für die übrigen Typen (z.B. Bool,
+    // eigene Typen) gibt es keinen verträglichen Hash; sie kommen in den Bucket LooseDoc.
+    if( loose )
+        *loose = false;
+    const int t = doc.userType();
+    switch( t )
+    {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+    case QMetaType::Float:
+        return _hashNumber( doc.toDouble() );
+    case QVariant::String:
+    case QVariant::ByteArray:
+        {
+            const QString str = doc.toString();
+            bool ok;
+            const double d = str.toDouble( &ok );
+            return ( ok ) ? _hashNumber( d ) : qHash( str );
+        }
+    default:
+        break;
+    }
+    const char* name = QMetaType::typeName( t );
+    if( name != 0 && name[0] != 0 && name[ qstrlen( name ) - 1 ] == '*' )
+        return qHash( *static_cast<const quintptr*>( doc.constData() ) ); // Pointer als Doc-Key
+    if( loose )
+        *loose = true;
+    return LooseDoc;
+}
+
+int DocTabWidget::tabOf(QWidget* w) const
+{
+    if( d_stale != -1 )
+    {
+        // closeTab schiebt das Nachführen bis zur nächsten Abfrage auf
+        reindex( d_stale );
+        d_stale = -1;
+    }
+    return d_tabOf.value( w, -1 );
+}
+
+void DocTabWidget::reindex(int from, int to) const
+{
+    if( to < 0 || to >= count() )
+        to = count() - 1;
+    for( int i = from; i <= to; i++ )
+        d_tabOf[ widget(i) ] = i;
+}
+
 int DocTabWidget::findDoc(const QVariant& doc )
 {
-	for( int i = 0; i < d_views.size(); i++ )
-	{
-        if( d_views[i] == doc )
-		{
-			return i;
-		}
-	}
+    if( doc.isNull() )
+    {
+        // fixed Tabs sind nicht im Index
+        for( int i = 0; i < d_views.size(); i++ )
+            if( d_views[i].isNull() )
+                return i;
+        return -1;
+    }
+    bool loose;
+    const uint h = hashDoc( doc, &loose );
+    if( loose )
+    {
+        // kann jedem Doc gleich sein
+        for( int i = 0; i < d_views.size(); i++ )
+            if( !d_views[i].isNull() && d_views[i] == doc )
+                return i;
+        return -1;
+    }
+    const int i = findIn( h, doc );
+    if( i != -1 || h == LooseDoc )
+        return i;
+    return findIn( LooseDoc, doc );
+}
+
+int DocTabWidget::findIn(uint h, const QVariant& doc) const
+{
+    QMultiHash<uint,QWidget*>::const_iterator it = d_byDoc.find( h );
+    while( it != d_byDoc.end() && it.key() == h )
+    {
+        const int i = tabOf( it.value() );
+        if( i != -1 && d_views[i] == doc )
+            return i;
+        ++it;
+    }
 	return -1;
 }
 
 int DocTabWidget::showWidget( QWidget* w )
 {
-	for( int i = 0; i < count(); i++ )
-	{
-		if( widget(i) == w )
-		{
-			setCurrentIndex( i );
-			return i;
-		}
-	}
-	return -1;
+    const int i = tabOf( w );
+    if( i != -1 )
+        setCurrentIndex( i );
+    return i;
 }
 
 int DocTabWidget::addDoc(QWidget* w, const QVariant& doc, const QString& title )
 {
 	d_views.append( doc );
     addTab( w, title );
+    d_tabOf[w] = d_views.size() - 1;
+    d_byDoc.insert( hashDoc( doc ), w );
 	const bool old = d_backLock;
 	d_backLock = true;
 	setCurrentIndex( d_views.size() - 1 );
-	d_order.append( w );
+	mruTouch( w );
 	d_backLock = old;
 	return d_views.size() - 1;
 }
 
+int DocTabWidget::addLazyDoc(const QVariant& doc, const QString& title, DocTabFactory* factory)
+{
+    Q_ASSERT( factory != 0 );
+    QWidget* w = new QWidget( this );
+    // Alles vor addTab registrieren; beim ersten Tab ruft Qt sofort onTabChanged auf
+    d_lazy.insert( w, factory );
+    d_views.append( doc );
+    d_tabOf[w] = d_views.size() - 1;
+    d_byDoc.insert( hashDoc( doc ), w );
+    mruAppend( w );
+    addTab( w, title );
+    updateState();
+    return d_views.size() - 1;
+}
+
+QWidget* DocTabWidget::realize(int i)
+{
+    QWidget* ph = widget(i);
+    DocTabFactory* f = d_lazy.value( ph );
+    if( f == 0 )
+        return ph;
+    QWidget* w = f->create( d_views[i] );
+    if( w == 0 )
+    {
+        qWarning( "DocTabWidget::realize: factory returned no widget" );
+        return ph;
+    }
+    d_lazy.remove( ph );
+    delete f;
+    replaceWidget( i, w );
+    ph->deleteLater();
+    emit realized( i );
+    return w;
+}
+
+QWidget* DocTabWidget::replaceWidget(int i, QWidget* w)
+{
+    QWidget* before = widget(i);
+    const bool cur = currentIndex() == i;
+    const bool old = blockSignals( true );
+    setUpdatesEnabled( false );
+    insertTab( i, w, tabIcon( i ), tabText( i ) );
+    setTabToolTip( i, tabToolTip( i + 1 ) );
+    removeTab( i + 1 );
+    if( cur )
+        setCurrentIndex( i );
+    setUpdatesEnabled( true );
+    blockSignals( old );
+
+    const uint h = hashDoc( d_views[i] );
+    d_byDoc.remove( h, before );
+    d_byDoc.insert( h, w );
+    d_tabOf.remove( before );
+    d_tabOf[w] = i;
+    mruReplace( before, w );
+    return before;
+}
+
+void DocTabWidget::setHibernation(int budget, int idleSecs)
+{
+    d_budget = qMax( budget, 0 );
+    d_idleSecs = qMax( idleSecs, 0 );
+    if( d_budget == 0 && d_idleSecs == 0 )
+        d_hibernator.stop();
+    else
+    {
+        int ms = 10000;
+        if( d_idleSecs > 0 )
+            ms = qBound( 1000, d_idleSecs * 1000 / 4, ms );
+        d_hibernator.start( ms );
+    }
+}
+
+void DocTabWidget::setThumbnails(const QSize& size, int maxBytes)
+{
+    delete d_thumbs;
+    d_thumbs = 0;
+    if( size.isEmpty() )
+        return;
+    d_thumbs = new DocThumbnails( this, size, maxBytes );
+}
+
+static const quint32 s_sessionMagic = 0x44545753; // DTWS
+static const quint8 s_sessionVersion = 1;
+
+static bool _streamable( const QVariant& v )
+{
+    // QVariant::save macht den Stream bei Typen ohne Stream-Operatoren unbrauchbar (Qt4: Assert)
+    QByteArray tmp;
+    QDataStream out( &tmp, QIODevice::WriteOnly );
+    out.setVersion( QDataStream::Qt_4_6 );
+    return QMetaType::save( out, v.userType(), v.constData() );
+}
+
+QByteArray DocTabWidget::saveSession()
+{
+    QByteArray res;
+    QDataStream out( &res, QIODevice::WriteOnly );
+    out.setVersion( QDataStream::Qt_4_6 );
+    QHash<QWidget*,qint32> no; // Widget -> Nummer in der Sitzung
+    QList<int> tabs;
+    for( int i = 0; i < d_views.size(); i++ )
+    {
+        if( d_views[i].isNull() || !_streamable( d_views[i] ) )
+            continue;
+        no[widget(i)] = tabs.size();
+        tabs.append( i );
+    }
+    out << s_sessionMagic << s_sessionVersion << qint32( tabs.size() );
+    foreach( int i, tabs )
+    {
+        // Nicht realisierte Tabs werden dafür nicht geweckt
+        DocTabFactory* f = d_lazy.value( widget(i) );
+        const QByteArray state = ( f ) ? f->state() : saveTabState( i );
+        out << d_views[i] << tabText( i ) << tabToolTip( i ) << state;
+    }
+    QList<qint32> order;
+    for( DocTabMru::Iterator it = d_order.first(); it.isValid(); ++it )
+        if( no.contains( *it ) )
+            order.append( no.value( *it ) );
+    out << order << no.value( getCurrentTab(), -1 );
+    return res;
+}
+
+bool DocTabWidget::restoreSession(const QByteArray& data)
+{
+    if( !canRestoreTabs() )
+        return false; // die Tabs könnten mit dem Default von restoreTab nie erzeugt werden
+    QDataStream in( data );
+    in.setVersion( QDataStream::Qt_4_6 );
+    quint32 magic = 0;
+    quint8 version = 0;
+    qint32 n = 0;
+    in >> magic >> version >> n;
+    if( in.status() != QDataStream::Ok || magic != s_sessionMagic || version != s_sessionVersion || n < 0 )
+        return false;
+    // Zuerst alles lesen, damit eine beschädigte Sitzung nichts verändert
+    QList<QVariant> docs;
+    QStringList titles;
+    QStringList tips;
+    QList<QByteArray> states;
+    for( int j = 0; j < n && in.status() == QDataStream::Ok; j++ )
+    {
+        QVariant doc;
+        QString title, tip;
+        QByteArray state;
+        in >> doc >> title >> tip >> state;
+        docs.append( doc );
+        titles.append( title );
+        tips.append( tip );
+        states.append( state );
+    }
+    QList<qint32> order;
+    qint32 cur = -1;
+    in >> order >> cur;
+    if( in.status() != QDataStream::Ok )
+        return false;
+
+    setUpdatesEnabled( false );
+    const bool old = blockSignals( true ); // sonst realisiert onTabChanged den ersten Tab sofort
+    QVector<QWidget*> ws( n );
+    for( int j = 0; j < n; j++ )
+    {
+        int i = ( docs[j].isNull() ) ? -1 : findDoc( docs[j] );
+        if( i == -1 )
+        {
+            if( docs[j].isNull() )
+                continue; // doc war nicht schreibbar
+            i = addLazyDoc( docs[j], titles[j], new _HibernatedTab( this, states[j] ) );
+            setTabToolTip( i, tips[j] );
+        }
+        ws[j] = widget(i);
+    }
+    // vom ältesten zum jüngsten, so dass der zuletzt verwendete wieder am Anfang steht
+    for( int j = order.size() - 1; j >= 0; j-- )
+        if( order[j] >= 0 && order[j] < n && ws[order[j]] != 0 )
+            mruTouch( ws[order[j]] );
+    if( cur >= 0 && cur < n && ws[cur] != 0 )
+        setCurrentIndex( tabOf( ws[cur] ) );
+    blockSignals( old );
+    emit currentChanged( currentIndex() ); // ruft onTabChanged auf und realisiert nur diesen Tab
+    setUpdatesEnabled( true );
+    return true;
+}
+
+bool DocTabWidget::hibernate(int i)
+{
+    if( !canRestoreTabs() || i < 0 || i >= d_views.size() || d_views[i].isNull() || i == currentIndex() ||
+            !isRealized(i) || isUnsaved(i) )
+        return false;
+    const QByteArray state = saveTabState(i);
+    if( state.isNull() )
+        return false;
+    QWidget* ph = new QWidget( this );
+    d_lazy.insert( ph, new _HibernatedTab( this, state ) );
+    QWidget* w = replaceWidget( i, ph );
+    w->deleteLater();
+    return true;
+}
+
+void DocTabWidget::hibernateIdle()
+{
+    if( !canRestoreTabs() )
+        return;
+    int total = 0;
+    if( d_budget > 0 )
+    {
+        for( int i = 0; i < d_views.size(); i++ )
+            if( !d_views[i].isNull() && isRealized(i) )
+                total += tabCost(i);
+    }
+    // Vom am längsten nicht verwendeten Tab her; zuerst sammeln, da hibernate die Widgets ersetzt
+    QList<QWidget*> l;
+    for( DocTabMru::Iterator it = d_order.last(); it.isValid(); --it )
+    {
+        const bool overBudget = d_budget > 0 && total > d_budget;
+        const bool idle = d_idleSecs > 0 && d_order.now() - it.lastUsed() > qint64( d_idleSecs ) * 1000;
+        if( !overBudget && !idle )
+            break;
+        const int i = tabOf( *it );
+        if( i == -1 || d_views[i].isNull() || !isRealized(i) || i == currentIndex() || isUnsaved(i) )
+            continue;
+        l.append( *it );
+        total -= tabCost(i);
+    }
+    foreach( QWidget* w, l )
+        hibernate( tabOf( w ) );
+}
+
 void DocTabWidget::onCloseDoc()
 {
 	const int i = currentIndex();
@@ -134,16 +650,18 @@ void DocTabWidget::onTabChanged( int i )
 {
 	if( i < 0 ) // bei remove des letzen Tab kommt -1
 	{
-		d_order.clear();
+		mruClear();
 	}else
 	{
-		const int pos = d_order.indexOf( widget(i) );
-		if( pos != -1 )
-		{
-			QWidget* w = d_order[pos];
-			d_order.removeAt( pos );
-			d_order.append( w );
-		}
+		QWidget* w = widget(i);
+		// Das Abbild des bisherigen Tabs ist veraltet; neu aufgenommen wird später und nur bei Bedarf
+		QWidget* prev = ( d_thumbs && d_order.first().isValid() ) ? *d_order.first() : 0;
+		if( prev != 0 && prev != w && d_tabOf.contains( prev ) && !d_lazy.contains( prev ) )
+			d_thumbs->invalidate( prev );
+		if( d_lazy.contains( w ) )
+			w = realize( i );
+		if( d_order.contains( w ) )
+			mruTouch( w );
 	}
 	updateState();
 }
@@ -155,7 +673,7 @@ void DocTabWidget::updateState()
         tabBar()->setVisible( count() > 1 );
 }
 
-bool DocTabWidget::checkSavedAll(bool butCur)
+bool DocTabWidget::checkSavedAll(bool butCur, QSet<int>& failed)
 {
     const int except = butCur ? currentIndex() : -1;
     QList<int> toSave;
@@ -163,7 +681,7 @@ bool DocTabWidget::checkSavedAll(bool butCur)
     {
         if( d_views[i].isNull() )
             continue;
-        else if( i != except && isUnsaved(i) )
+        else if( i != except && isRealized(i) && isUnsaved(i) )
             toSave << i;
     }
     if( !toSave.isEmpty() )
@@ -173,10 +691,15 @@ bool DocTabWidget::checkSavedAll(bool butCur)
                                QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel, QMessageBox::Yes ) )
         {
         case QMessageBox::Yes:
-            foreach( int i, toSave )
-                if( !save(i) )
-                    QMessageBox::critical( this, tr("Closing tabs"), tr("Error while saving the tabs") );
-                    return false;
+            {
+                QStringList errors;
+                foreach( int i, saveTabs( toSave, errors ) )
+                    failed.insert( i );
+                if( !errors.isEmpty() )
+                    QMessageBox::critical( this, tr("Closing tabs"),
+                                           tr("The following tabs could not be saved and stay open:\n\n%1").
+                                           arg( errors.join( "\n" ) ) );
+            }
             break;
         case QMessageBox::No:
             break;
@@ -187,6 +710,105 @@ bool DocTabWidget::checkSavedAll(bool butCur)
     return true;
 }
 
+struct _SaveResult
+{
+    bool d_ok;
+    QString d_error;
+    _SaveResult():d_ok(false) {}
+};
+
+class _SaveJob : public QRunnable
+{
+public:
+    _SaveJob( DocTabSaver* s, _SaveResult* r, QAtomicInt* done, QAtomicInt* cancel ):
+        d_saver(s),d_res(r),d_done(done),d_cancel(cancel) {}
+    void run()
+    {
+        // jeder Job schreibt nur in sein eigenes Resultat
+        if( d_cancel->fetchAndAddOrdered( 0 ) != 0 )
+            d_res->d_error = DocTabWidget::tr("canceled");
+        else
+            d_res->d_ok = d_saver->write( d_res->d_error );
+        d_done->ref();
+    }
+private:
+    DocTabSaver* d_saver;
+    _SaveResult* d_res;
+    QAtomicInt* d_done;
+    QAtomicInt* d_cancel;
+};
+
+QList<int> DocTabWidget::saveTabs(const QList<int>& tabs, QStringList& errors)
+{
+    // Schnappschüsse im GUI-Thread, solange die Widgets unverändert sind
+    QList<int> jobTabs;
+    QList<DocTabSaver*> savers;
+    QList<int> direct;
+    foreach( int i, tabs )
+    {
+        DocTabSaver* s = snapshotTab( i );
+        if( s )
+        {
+            jobTabs.append( i );
+            savers.append( s );
+        }else
+            direct.append( i );
+    }
+
+    QVector<_SaveResult> res( savers.size() );
+    QAtomicInt done( 0 );
+    QAtomicInt cancel( 0 );
+    QProgressDialog dlg( tr("Saving tabs..."), tr("Cancel"), 0, tabs.size(), this );
+    dlg.setWindowModality( Qt::WindowModal );
+    dlg.setMinimumDuration( 500 );
+    d_hibernator.stop(); // kein hibernateIdle während processEvents
+    QThreadPool pool;
+    for( int j = 0; j < savers.size(); j++ )
+        pool.start( new _SaveJob( savers[j], &res[j], &done, &cancel ) );
+
+    QList<int> failed;
+    // Tabs ohne Schnappschuss werden in der Zwischenzeit wie bisher direkt gespeichert
+    int n = 0;
+    foreach( int i, direct )
+    {
+        QString err;
+        if( dlg.wasCanceled() )
+            err = tr("canceled");
+        else if( !save( i ) )
+            err = tr("error while saving the tab");
+        if( !err.isEmpty() )
+        {
+            failed.append( i );
+            errors << QString("%1: %2").arg( tabText( i ) ).arg( err );
+        }
+        dlg.setValue( ++n + done.fetchAndAddOrdered( 0 ) );
+        QApplication::processEvents();
+    }
+    while( !pool.waitForDone( 50 ) )
+    {
+        if( dlg.wasCanceled() )
+            cancel.testAndSetOrdered( 0, 1 ); // laufende Jobs schreiben fertig, wartende nicht mehr
+        dlg.setValue( direct.size() + done.fetchAndAddOrdered( 0 ) );
+        QApplication::processEvents();
+    }
+    dlg.setValue( tabs.size() );
+
+    for( int j = 0; j < savers.size(); j++ )
+    {
+        if( res[j].d_ok )
+            savedTab( jobTabs[j] );
+        else
+        {
+            failed.append( jobTabs[j] );
+            errors << QString("%1: %2").arg( tabText( jobTabs[j] ) ).arg( res[j].d_error );
+        }
+    }
+    qDeleteAll( savers );
+    if( d_budget > 0 || d_idleSecs > 0 )
+        d_hibernator.start();
+    return failed;
+}
+
 bool DocTabWidget::isUnsaved(int)
 {
     return false;
@@ -206,43 +828,140 @@ void DocTabWidget::closeTab( int i )
 	emit closing( i );
 	QWidget* w = widget(i);
 	Q_ASSERT( w != 0 );
-	for( int j = 0; j < d_order.size(); j++ )
-	{
-		if( d_order[j] == w ) 
-		{
-			d_order.removeAt( j );
-			break;
-		}
-	}
+	mruRemove( w );
+    d_byDoc.remove( hashDoc( d_views[i] ), w );
+    d_tabOf.remove( w );
+    delete d_lazy.take( w );
     d_views.removeAt( i );
     removeTab( i );
+    if( i < count() && ( d_stale == -1 || i < d_stale ) )
+        d_stale = i; // erst bei der nächsten Abfrage, damit das Schliessen vieler Tabs nicht O(n^2) wird
     w->deleteLater();
 }
 
+void DocTabWidget::closeTabs(const QList<int>& tabs)
+{
+    QList<int> l;
+    foreach( int i, tabs )
+    {
+        if( i >= 0 && i < d_views.size() && !d_views[i].isNull() )
+            l.append( i );
+    }
+    if( l.isEmpty() )
+        return;
+    qSort( l );
+    for( int j = l.size() - 1; j > 0; j-- )
+        if( l[j] == l[j-1] )
+            l.removeAt( j );
+
+    // Alle Meldungen vor dem Entfernen, damit die Indizes noch stimmen
+    for( int j = l.size() - 1; j >= 0; j-- )
+        emit closing( l[j] );
+    emit closingTabs( l );
+
+    QWidget* cur = getCurrentTab();
+    const int curIndex = currentIndex();
+    setUpdatesEnabled( false );
+    const bool old = blockSignals( true ); // kein currentChanged, onTabChanged und updateState pro Tab
+    for( int j = l.size() - 1; j >= 0; j-- )
+    {
+        // absteigend, damit die übrigen Indizes gültig bleiben
+        const int i = l[j];
+        QWidget* w = widget(i);
+        d_byDoc.remove( hashDoc( d_views[i] ), w );
+        d_tabOf.remove( w );
+        d_order.remove( w ); // d_selector wird unten einmal benachrichtigt
+        if( d_thumbs )
+            d_thumbs->remove( w );
+        delete d_lazy.take( w );
+        d_views.removeAt( i );
+        removeTab( i );
+        w->deleteLater();
+    }
+    if( l.first() < count() && ( d_stale == -1 || l.first() < d_stale ) )
+        d_stale = l.first();
+    if( d_selector )
+        d_selector->mruReset(); // einmal statt einer removeRows pro Tab
+    // Neu aktiv wird der bisherige Tab oder der zuletzt verwendete der übrigen
+    QWidget* next = cur;
+    if( !d_tabOf.contains( next ) )
+        next = ( d_order.first().isValid() ) ? *d_order.first() : 0;
+    if( next )
+        setCurrentIndex( tabOf( next ) );
+    blockSignals( old );
+    // auch wenn nur der Index des aktuellen Tabs gewechselt hat, weil Tabs davor geschlossen wurden
+    if( next != cur || next == 0 || currentIndex() != curIndex )
+        emit currentChanged( currentIndex() ); // einmal; ruft auch onTabChanged auf
+    else
+        updateState();
+    setUpdatesEnabled( true );
+}
+
 void DocTabWidget::onDocSelect()
 {
 	ENABLED_IF( count() > 1 );
 
-	for( int i = 0; i < d_order.size(); i++ )
-		d_order[i]->setObjectName( tabText( indexOf( d_order[i] ) ) ); // ev. teuer
-	DocSelector* ds = new DocSelector( d_order );
-    connect( ds, SIGNAL( sigSelected( QWidget* ) ), this, SLOT( onSelectDoc( QWidget* ) ) );
+	if( d_selector == 0 )
+	{
+		d_selector = new DocSelector( this );
+		connect( d_selector, SIGNAL( sigSelected( QWidget* ) ), this, SLOT( onSelectDoc( QWidget* ) ) );
+	}
+	d_selector->popup();
+}
+
+void DocTabWidget::mruTouch(QWidget* w)
+{
+    d_order.touch( w );
+    if( d_selector )
+        d_selector->mruTouched( w );
+}
+
+void DocTabWidget::mruAppend(QWidget* w)
+{
+    d_order.append( w );
+    if( d_selector )
+        d_selector->mruAppended( w );
+}
+
+void DocTabWidget::mruRemove(QWidget* w)
+{
+    d_order.remove( w );
+    if( d_thumbs )
+        d_thumbs->remove( w );
+    if( d_selector )
+        d_selector->mruRemoved( w );
+}
+
+void DocTabWidget::mruReplace(QWidget* before, QWidget* after)
+{
+    d_order.replace( before, after );
+    if( d_thumbs )
+        d_thumbs->rename( before, after );
+    if( d_selector )
+        d_selector->mruReplaced( before, after );
+}
+
+void DocTabWidget::mruClear()
+{
+    d_order.clear();
+    if( d_thumbs )
+        d_thumbs->clear();
+    if( d_selector )
+        d_selector->mruReset();
 }
 
 void DocTabWidget::onCloseAll()
 {
     ENABLED_IF(!d_views.isEmpty());
 
-    if( !checkSavedAll(false) )
+    QSet<int> failed;
+    if( !checkSavedAll(false, failed) )
         return;
-    int i = 0;
-    while( i < d_views.size() )
-    {
-        if( d_views[i].isNull() )
-            i++;
-        else
-            closeTab(i);
-    }
+    QList<int> l;
+    for( int i = 0; i < d_views.size(); i++ )
+        if( !d_views[i].isNull() && !failed.contains( i ) )
+            l.append( i );
+    closeTabs( l );
 }
 
 void DocTabWidget::onCloseAllButThis()
@@ -250,27 +969,28 @@ void DocTabWidget::onCloseAllButThis()
     const int cur = currentIndex();
     ENABLED_IF( cur != -1 && !d_views[cur].isNull() );
 
-    if( !checkSavedAll(true) )
+    QSet<int> failed;
+    if( !checkSavedAll(true, failed) )
         return;
-    QWidget* w = widget(cur);
-    int i = 0;
-    while( i < d_views.size() )
-    {
-        if( d_views[i].isNull() || widget(i) == w )
-            i++;
-        else
-            closeTab(i);
-    }
+    QList<int> l;
+    for( int i = 0; i < d_views.size(); i++ )
+        if( !d_views[i].isNull() && i != cur && !failed.contains( i ) )
+            l.append( i );
+    closeTabs( l );
 }
 
 void DocTabWidget::onSelectDoc( QWidget* w )
 {
-	for( int i = 0; i < count(); i++ )
-		if( widget(i) == w )
-		{
-			setCurrentIndex( i );
-			return;
-		}
+	const int i = tabOf( w );
+	if( i != -1 )
+		setCurrentIndex( i );
+}
+
+void DocTabWidget::onTabMoved(int from, int to)
+{
+    // QTabWidget hat den Stack bereits umgestellt; d_views war bisher nicht nachgeführt
+    d_views.move( from, to );
+    reindex( qMin( from, to ), qMax( from, to ) );
 }
 
 QVariant DocTabWidget::getCurrentDoc() const
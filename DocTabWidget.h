@@ -22,31 +22,175 @@
 
 #include <QTabWidget>
 #include <QVariant>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QCache>
+#include <QPixmap>
+#include <QSet>
+#include <QStringList>
 
 class QToolButton;
+class DocSelector;
 
 // adaptiert aus CrossLine
 
+// Reihenfolge der zuletzt verwendeten Tabs als doppelt verkettete Liste mit Hash-Index, so dass
+// Aktivieren und Entfernen O(1) sind. Der Anfang ist der zuletzt verwendete Tab.
+class DocTabMru
+{
+    struct Node
+    {
+        QWidget* d_w;
+        Node* d_prev;
+        Node* d_next;
+        qint64 d_used; // ms seit Erzeugung der Liste
+    };
+public:
+    class Iterator
+    {
+    public:
+        Iterator():d_n(0) {}
+        bool isValid() const { return d_n != 0; }
+        QWidget* operator*() const { return d_n->d_w; }
+        qint64 lastUsed() const { return d_n->d_used; }
+        Iterator& operator++() { d_n = d_n->d_next; return *this; }
+        Iterator& operator--() { d_n = d_n->d_prev; return *this; }
+        bool operator==( const Iterator& rhs ) const { return d_n == rhs.d_n; }
+        bool operator!=( const Iterator& rhs ) const { return d_n != rhs.d_n; }
+    private:
+        friend class DocTabMru;
+        Iterator( Node* n ):d_n(n) {}
+        Node* d_n;
+    };
+
+    DocTabMru():d_head(0),d_tail(0) { d_clock.start(); }
+    ~DocTabMru() { clear(); }
+    void touch( QWidget* ); // an den Anfang; fügt ein, falls noch nicht enthalten
+    void append( QWidget* ); // ans Ende, d.h. am längsten nicht verwendet
+    void replace( QWidget* before, QWidget* after ); // an derselben Position
+    void remove( QWidget* );
+    void clear();
+    bool contains( QWidget* w ) const { return d_nodes.contains( w ); }
+    int size() const { return d_nodes.size(); }
+    Iterator first() const { return Iterator( d_head ); } // zuletzt verwendet
+    Iterator last() const { return Iterator( d_tail ); }
+    qint64 now() const { return d_clock.elapsed(); } // Zeitbasis von lastUsed()
+private:
+    DocTabMru( const DocTabMru& );
+    DocTabMru& operator=( const DocTabMru& );
+    void unlink( Node* );
+    QHash<QWidget*,Node*> d_nodes;
+    Node* d_head;
+    Node* d_tail;
+    QElapsedTimer d_clock;
+};
+
+// Verkleinerte Abbilder der Tabs für DocSelector in einem LRU-Cache, dessen Kosten in Bytes
+// gerechnet werden. invalidate() merkt sich nur den Tab; aufgenommen wird erst, wenn find() einmal
+// aufgerufen wurde, es also einen Abnehmer gibt, und dann gedrosselt ein Tab pro Timer-Umlauf, direkt
+// in der Grösse des Abbilds mit QWidget::render().
+class DocThumbnails : public QObject
+{
+    Q_OBJECT
+public:
+    DocThumbnails( QObject*, const QSize& size, int maxBytes );
+    ~DocThumbnails();
+    void invalidate( QWidget* ); // z.B. beim Verlassen des Tabs
+    QPixmap find( QWidget* ); // null falls (noch) nicht vorhanden; blockiert nie
+    const QPixmap& placeholder() const { return d_placeholder; }
+    void rename( QWidget* before, QWidget* after ); // z.B. bei hibernate
+    void remove( QWidget* );
+    void clear();
+    const QSize& size() const { return d_size; }
+signals:
+    void ready( QWidget* );
+protected slots:
+    void onIdle();
+private:
+    QPixmap render( QWidget* ) const;
+    QCache<QWidget*,QPixmap> d_cache;
+    QList<QWidget*> d_dirty; // neu aufzunehmen, ältester zuerst
+    QTimer d_idle;
+    QSize d_size;
+    QPixmap d_placeholder;
+    bool d_wanted; // find() wurde aufgerufen
+};
+
+// Erzeugt das Widget eines mit DocTabWidget::addLazyDoc hinzugefügten Tabs, wenn dieser zum
+// ersten Mal aktiv wird.
+class DocTabFactory
+{
+public:
+    virtual ~DocTabFactory() {}
+    virtual QWidget* create( const QVariant& doc ) = 0;
+    virtual QByteArray state() const { return QByteArray(); } // für saveSession, solange nicht realisiert
+};
+
+// Schnappschuss eines ungesicherten Tabs, erzeugt von DocTabWidget::snapshotTab im GUI-Thread.
+// write() kodiert und schreibt ihn danach in einem Thread des Pools und darf darum nicht mehr auf
+// das Widget zugreifen.
+class DocTabSaver
+{
+public:
+    virtual ~DocTabSaver() {}
+    virtual bool write( QString& error ) = 0;
+};
+
 class DocTabWidget : public QTabWidget
 {
     Q_OBJECT
 public:
     DocTabWidget( QWidget*, bool hideSingleTab = true );
+    ~DocTabWidget();
     int addFixed( QWidget*, const QString& title );
     int findDoc(const QVariant& doc ); // Index oder -1
     int showDoc( const QVariant& doc ); // Index oder -1
     int addDoc( QWidget*, const QVariant& doc, const QString& title = QString() );
+    // Fügt nur einen Platzhalter ein, ohne ihn zu aktivieren; übernimmt factory
+    int addLazyDoc( const QVariant& doc, const QString& title, DocTabFactory* factory );
+    bool isRealized( int i ) const { return !d_lazy.contains( widget(i) ); }
+    // Ersetzt den Platzhalter durch das Widget der Factory; liefert diese keines, bleibt der Platzhalter
+    // samt Factory bestehen und wird bei der nächsten Aktivierung erneut versucht
+    QWidget* realize( int i );
+
+    // Ersetzt am längsten nicht verwendete Tabs durch Platzhalter, deren Zustand mit saveTabState
+    // gesichert und bei der Aktivierung mit restoreTab wiederhergestellt wird; nur wirksam, wenn
+    // canRestoreTabs() true ist. budget ist die Summe von tabCost über alle realisierten Tabs
+    // (0..unbegrenzt), also ohne eigenes tabCost die Anzahl realisierter Tabs; idleSecs die Zeit seit
+    // der letzten Verwendung (0..nie). Tabs mit ungesicherten Änderungen, fixed und der aktuelle Tab bleiben.
+    void setHibernation( int budget, int idleSecs );
+    bool hibernate( int i );
+    // Abbilder für DocSelector, ungültig beim Verlassen eines Tabs; ein leeres size schaltet ab
+    void setThumbnails( const QSize& size, int maxBytes = 16 * 1024 * 1024 );
+    DocThumbnails* thumbnails() const { return d_thumbs; }
+
+    // Sitzung mit doc, Titel, Tooltip und saveTabState aller Tabs (ausser fixed) sowie der MRU-Reihenfolge.
+    // Die docs müssen mit QDataStream schreibbar sein, also z.B. Pfade und keine Zeiger; Tabs mit
+    // anderen docs werden weggelassen.
+    QByteArray saveSession();
+    // Fügt die Tabs mit addLazyDoc hinzu; nur der aktuelle wird sofort mit restoreTab erzeugt, die
+    // übrigen bei der ersten Aktivierung. Bereits offene docs werden nicht verdoppelt. Gibt false
+    // zurück, ohne etwas zu ändern, wenn canRestoreTabs() false ist.
+    bool restoreSession( const QByteArray& );
     int showWidget( QWidget* );
     QVariant getCurrentDoc() const;
     QVariant getDoc( int i ) const;
     QWidget* getCurrentTab() const;
     QTabBar* getBar() const { return tabBar(); }
+    int tabOf( QWidget* w ) const;
+    const DocTabMru& mru() const { return d_order; }
     void closeTab( int i );
+    // Schliesst alle Tabs in einem Durchgang; ohne Zwischenzustände, fixed Tabs werden ignoriert
+    void closeTabs( const QList<int>& );
     void setCloserIcon( const QString& );
     // overrides
     QSize minimumSizeHint () const { return QSize( 30, 30 ); } // RISK
 signals:
     void closing(int);
+    // Bei closeTabs nach den einzelnen closing(int); Indizes aufsteigend, alle noch gültig
+    void closingTabs( const QList<int>& );
+    void realized( int ); // der Platzhalter wurde durch das richtige Widget ersetzt
 public slots:
     void onCloseDoc(); // Menübefehl
     void onDocSelect(); // Menübefehl
@@ -55,14 +199,54 @@ public slots:
 protected slots:
     void onTabChanged( int );
     void onSelectDoc( QWidget* );
+    void onTabMoved( int from, int to );
+    void hibernateIdle();
 protected:
     void updateState();
-    bool checkSavedAll(bool butCur );
+    void reindex( int from, int to = -1 ) const; // d_tabOf für die Tabs from..to (-1..bis Ende)
+    enum { LooseDoc = 0 }; // Bucket in d_byDoc für Docs ohne verträglichen Hash
+    static uint hashDoc( const QVariant&, bool* loose = 0 );
+    int findIn( uint hash, const QVariant& doc ) const;
+    // Fragt nach und speichert; false bei Abbruch. In failed die Tabs, die nicht gespeichert werden
+    // konnten und darum offen bleiben sollen.
+    bool checkSavedAll(bool butCur, QSet<int>& failed );
+    // Speichert alle tabs parallel mit Fortschrittsanzeige; gibt die fehlgeschlagenen zurück und pro
+    // Fehler eine Zeile in errors.
+    QList<int> saveTabs( const QList<int>& tabs, QStringList& errors );
     virtual bool isUnsaved(int);
-    virtual bool save(int);
+    virtual bool save(int); // synchron, für Tabs ohne snapshotTab
+    virtual DocTabSaver* snapshotTab(int) { return 0; }
+    virtual void savedTab(int) {} // nach erfolgreichem write(), im GUI-Thread
+    // Hooks für hibernate und Sitzungen; ein null QByteArray bedeutet, dass der Tab nicht schlafen kann.
+    // restoreTab erhält bei restoreSession ein null state, wenn der Tab keinen Zustand geliefert hat.
+    // Wer beide überschreibt, muss auch canRestoreTabs überschreiben; sonst schläft kein Tab, da er
+    // mit dem Default von restoreTab nicht mehr geweckt werden könnte.
+    virtual bool canRestoreTabs() const { return false; }
+    virtual QByteArray saveTabState(int) { return QByteArray(); }
+    virtual QWidget* restoreTab( const QVariant& /* doc */, const QByteArray& /* state */ ) { return 0; }
+    // Kosten eines realisierten Tabs für das budget von setHibernation in einer beliebigen, aber
+    // einheitlichen Einheit, z.B. Bytes des Dokuments; der Default zählt nur die Tabs.
+    virtual int tabCost(int) { return 1; }
+    QWidget* replaceWidget( int i, QWidget* ); // gibt das bisherige Widget zurück, ohne es zu löschen
+    // Ändern d_order und melden es d_selector
+    void mruTouch( QWidget* );
+    void mruAppend( QWidget* );
+    void mruRemove( QWidget* );
+    void mruReplace( QWidget* before, QWidget* after );
+    void mruClear();
 private:
+    friend class _HibernatedTab;
     QList<QVariant> d_views; // isNull..fixed
-    QList<QWidget*> d_order;
+    QMultiHash<uint,QWidget*> d_byDoc; // hashDoc(doc) -> Widget; nur Docs, keine fixed
+    mutable QHash<QWidget*,int> d_tabOf; // Widget -> Tab-Index
+    mutable int d_stale; // ab diesem Tab ist d_tabOf nach closeTab veraltet; -1..aktuell
+    DocTabMru d_order;
+    DocSelector* d_selector; // wird beim ersten onDocSelect erzeugt und danach nur noch gezeigt
+    DocThumbnails* d_thumbs;
+    QHash<QWidget*,DocTabFactory*> d_lazy; // Platzhalter -> Factory
+    QTimer d_hibernator;
+    int d_budget;
+    int d_idleSecs;
     QToolButton* d_closer;
     bool d_backLock;
     bool d_observed;
@@ -0,0 +1,347 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License (LGPL) as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * You should have received a copy of the LGPL along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "EventRecorder.h"
+#include "ControllerChain.h"
+#include <QApplication>
+#include <QEventLoop>
+#include <QTimer>
+#include <QWidget>
+#include <QKeyEvent>
+#include <QtDebug>
+using namespace Gui;
+
+EventRecorder::EventRecorder(QWidget* view):
+	Controller( view, MouseEvents | WheelEvents | KeyEvents | FocusEvents | EnterLeaveEvents |
+		PaintEvents | GeometryEvents ),d_last(0),d_count(0)
+{
+	// Vor allen Controllern der Kette, damit auch konsumierte Events aufgezeichnet werden
+	d_host = ControllerChain::get( view );
+	d_host->insert( 0, this, false );
+}
+
+EventRecorder::~EventRecorder()
+{
+	stop();
+}
+
+bool EventRecorder::start(const QString& path)
+{
+	stop();
+	d_file.setFileName( path );
+	if( !d_file.open( QIODevice::WriteOnly ) )
+	{
+		qWarning() << "EventRecorder: cannot write" << path << d_file.errorString();
+		return false;
+	}
+	d_out.setDevice( &d_file );
+	d_out.setVersion( QDataStream::Qt_4_6 );
+	d_out << quint32( Magic ) << quint16( Version );
+	d_count = 0;
+	d_last = 0;
+	d_clock.start();
+	if( d_host )
+		d_host->setEnabled( this, true );
+	return true;
+}
+
+void EventRecorder::stop()
+{
+	if( !d_file.isOpen() )
+		return;
+	if( d_host )
+		d_host->setEnabled( this, false );
+	d_out.setDevice( 0 );
+	d_file.close();
+}
+
+bool EventRecorder::record(QEvent* event)
+{
+	if( !d_file.isOpen() )
+		return false;
+	const int t = event->type();
+	// Pro Event: Abstand zum vorherigen in us, Typ, typabhängige Daten
+	const qint64 now = d_clock.nsecsElapsed() / 1000;
+	d_out << quint32( qMin( now - d_last, qint64( 0xffffffff ) ) ) << quint16( t );
+	d_last = now;
+	switch( t )
+	{
+	case QEvent::MouseMove:
+	case QEvent::MouseButtonPress:
+	case QEvent::MouseButtonRelease:
+	case QEvent::MouseButtonDblClick:
+		{
+			QMouseEvent* e = static_cast<QMouseEvent*>( event );
+			d_out << e->pos() << qint32( e->button() ) << qint32( e->buttons() ) << qint32( e->modifiers() );
+		}
+		break;
+	case QEvent::Wheel:
+		{
+			// Dasselbe Format für alle Qt-Versionen; vor Qt 5.12 nur angleDelta in einer Richtung
+			QWheelEvent* e = static_cast<QWheelEvent*>( event );
+#if QT_VERSION >= 0x050E00
+			const QPoint pos = e->position().toPoint();
+#else
+			const QPoint pos = e->pos();
+#endif
+#if QT_VERSION >= 0x050C00
+			d_out << pos << e->angleDelta() << e->pixelDelta() << qint8( e->phase() ) << e->inverted();
+#else
+			const QPoint angle = ( e->orientation() == Qt::Horizontal ) ?
+						QPoint( e->delta(), 0 ) : QPoint( 0, e->delta() );
+			d_out << pos << angle << QPoint() << qint8( 0 ) << false;
+#endif
+			d_out << qint32( e->buttons() ) << qint32( e->modifiers() );
+		}
+		break;
+	case QEvent::KeyPress:
+	case QEvent::KeyRelease:
+		{
+			QKeyEvent* e = static_cast<QKeyEvent*>( event );
+			d_out << qint32( e->key() ) << qint32( e->modifiers() ) << e->text() << e->isAutoRepeat();
+		}
+		break;
+	case QEvent::FocusIn:
+	case QEvent::FocusOut:
+		d_out << qint8( static_cast<QFocusEvent*>( event )->reason() );
+		break;
+	case QEvent::Paint:
+		d_out << static_cast<QPaintEvent*>( event )->rect();
+		break;
+	case QEvent::Resize:
+		d_out << static_cast<QResizeEvent*>( event )->size() << static_cast<QResizeEvent*>( event )->oldSize();
+		break;
+	default:
+		break;
+	}
+	d_count++;
+	return false;
+}
+
+EventReplayer::EventReplayer(QWidget* view):d_view(view),d_totalNs(0),d_count(0)
+{
+	Q_ASSERT( view != 0 );
+}
+
+void EventReplayer::account(int type, qint64 ns)
+{
+	Stats& s = d_stats[type];
+	s.d_count++;
+	s.d_totalNs += ns;
+	if( ns > s.d_maxNs )
+		s.d_maxNs = ns;
+}
+
+void EventReplayer::send(QEvent* e)
+{
+	QElapsedTimer t;
+	t.start();
+	QApplication::sendEvent( d_view, e ); // läuft durch alle Filter, also auch durch die Controller
+	account( e->type(), t.nsecsElapsed() );
+}
+
+bool EventReplayer::run(const QString& path, bool realTime)
+{
+	d_stats.clear();
+	d_error.clear();
+	d_totalNs = 0;
+	d_count = 0;
+	QFile f( path );
+	if( !f.open( QIODevice::ReadOnly ) )
+	{
+		d_error = f.errorString();
+		return false;
+	}
+	QDataStream in( &f );
+	in.setVersion( QDataStream::Qt_4_6 );
+	quint32 magic;
+	quint16 version;
+	in >> magic >> version;
+	if( magic != quint32( EventRecorder::Magic ) || version > EventRecorder::Version )
+	{
+		d_error = QString( "%1 is not a supported event recording" ).arg( path );
+		return false;
+	}
+	// Im Echtzeit-Modus wird bis zum nächsten Event in einer lokalen Event-Loop gewartet
+	QEventLoop wait;
+	QTimer timer;
+	timer.setSingleShot( true );
+#if QT_VERSION >= 0x050000
+	timer.setTimerType( Qt::PreciseTimer );
+#endif
+	QObject::connect( &timer, SIGNAL(timeout()), &wait, SLOT(quit()) );
+	QElapsedTimer clock;
+	clock.start();
+	qint64 due = 0; // us
+	while( !in.atEnd() && d_view )
+	{
+		quint32 dt;
+		quint16 type;
+		in >> dt >> type;
+		due += dt;
+		if( realTime )
+		{
+			const qint64 ms = ( due - clock.nsecsElapsed() / 1000 + 999 ) / 1000;
+			if( ms > 0 )
+			{
+				timer.start( int( ms ) );
+				wait.exec();
+				if( d_view.isNull() )
+					break;
+			}
+		}
+		const QEvent::Type t = QEvent::Type( type );
+		switch( t )
+		{
+		case QEvent::MouseMove:
+		case QEvent::MouseButtonPress:
+		case QEvent::MouseButtonRelease:
+		case QEvent::MouseButtonDblClick:
+			{
+				QPoint pos;
+				qint32 button, buttons, mods;
+				in >> pos >> button >> buttons >> mods;
+				QMouseEvent e( t, pos, d_view->mapToGlobal( pos ), Qt::MouseButton( button ),
+							   Qt::MouseButtons( buttons ), Qt::KeyboardModifiers( mods ) );
+				send( &e );
+			}
+			break;
+		case QEvent::Wheel:
+			{
+				QPoint pos, angle, pixel;
+				qint32 buttons, mods;
+				qint8 phase = 0;
+				bool inverted = false;
+				if( version < 2 )
+				{
+					qint32 delta;
+					qint8 o;
+					in >> pos >> delta >> o >> buttons >> mods;
+					angle = ( o == Qt::Horizontal ) ? QPoint( delta, 0 ) : QPoint( 0, delta );
+				}else
+					in >> pos >> angle >> pixel >> phase >> inverted >> buttons >> mods;
+#if QT_VERSION >= 0x050C00
+				QWheelEvent e( QPointF( pos ), QPointF( d_view->mapToGlobal( pos ) ), pixel, angle,
+							   Qt::MouseButtons( buttons ), Qt::KeyboardModifiers( mods ),
+							   Qt::ScrollPhase( phase ), inverted );
+#else
+				Q_UNUSED( phase );
+				Q_UNUSED( inverted );
+				const bool horizontal = angle.y() == 0 && angle.x() != 0;
+				QWheelEvent e( pos, d_view->mapToGlobal( pos ), ( horizontal ) ? angle.x() : angle.y(),
+							   Qt::MouseButtons( buttons ), Qt::KeyboardModifiers( mods ),
+							   ( horizontal ) ? Qt::Horizontal : Qt::Vertical );
+#endif
+				send( &e );
+			}
+			break;
+		case QEvent::KeyPress:
+		case QEvent::KeyRelease:
+			{
+				qint32 key, mods;
+				QString text;
+				bool autoRep;
+				in >> key >> mods >> text >> autoRep;
+				QKeyEvent e( t, key, Qt::KeyboardModifiers( mods ), text, autoRep );
+				send( &e );
+			}
+			break;
+		case QEvent::FocusIn:
+		case QEvent::FocusOut:
+			{
+				qint8 reason;
+				in >> reason;
+				QFocusEvent e( t, Qt::FocusReason( reason ) );
+				send( &e );
+			}
+			break;
+		case QEvent::Enter:
+		case QEvent::Leave:
+			{
+				QEvent e( t );
+				send( &e );
+			}
+			break;
+		case QEvent::Paint:
+			{
+				// Ein QPaintEvent darf nicht direkt gesendet werden; repaint() malt synchron
+				QRect r;
+				in >> r;
+				QElapsedTimer pt;
+				pt.start();
+				d_view->repaint( r );
+				account( t, pt.nsecsElapsed() );
+			}
+			break;
+		case QEvent::Resize:
+			{
+				QSize size, old;
+				in >> size >> old;
+				QElapsedTimer rt;
+				rt.start();
+				d_view->resize( size );
+				account( t, rt.nsecsElapsed() );
+			}
+			break;
+		default:
+			d_error = QString( "unknown event type %1 in %2" ).arg( type ).arg( path );
+			return false;
+		}
+		if( in.status() != QDataStream::Ok )
+		{
+			d_error = QString( "%1 is truncated" ).arg( path );
+			return false;
+		}
+		d_count++;
+	}
+	d_totalNs = clock.nsecsElapsed();
+	return true;
+}
+
+QByteArray EventReplayer::toJson() const
+{
+	QByteArray out = "{\"events\":" + QByteArray::number( d_count ) +
+			",\"total_ns\":" + QByteArray::number( d_totalNs ) + ",\"types\":[";
+	QHash<int,Stats>::const_iterator i;
+	bool first = true;
+	for( i = d_stats.begin(); i != d_stats.end(); ++i )
+	{
+		if( !first )
+			out += ',';
+		first = false;
+		const Stats& s = i.value();
+		out += "\n{\"type\":" + QByteArray::number( i.key() ) + ",\"count\":" + QByteArray::number( s.d_count );
+		out += ",\"total_ns\":" + QByteArray::number( s.d_totalNs );
+		out += ",\"mean_ns\":" + QByteArray::number( ( s.d_count ) ? s.d_totalNs / s.d_count : 0 );
+		out += ",\"max_ns\":" + QByteArray::number( s.d_maxNs ) + "}";
+	}
+	out += "\n]}\n";
+	return out;
+}
+
+void EventReplayer::dump() const
+{
+	qDebug() << "EventReplayer:" << d_count << "events in" << d_totalNs / 1000 << "us";
+	qDebug() << "type / count / mean / max in microseconds";
+	QHash<int,Stats>::const_iterator i;
+	for( i = d_stats.begin(); i != d_stats.end(); ++i )
+		qDebug() << i.key() << i.value().d_count <<
+					( ( i.value().d_count ) ? i.value().d_totalNs / i.value().d_count / 1000 : 0 ) <<
+					i.value().d_maxNs / 1000;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License (LGPL) as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * You should have received a copy of the LGPL along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GUI2_EVENTRECORDER
+#define _GUI2_EVENTRECORDER
+
+#include <GuiTools/Controller.h>
+#include <QFile>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QHash>
+
+namespace Gui
+{
+	class ControllerChain;
+
+	/// Zeichnet den Event-Strom einer View auf, soweit ihn Controller::dispatch verteilt (Maus, Wheel,
+	/// Tasten, Fokus, Enter/Leave, Paint, Resize), und schreibt ihn kompakt binär in eine Datei.
+	/// Der Recorder ist selber ein Controller an erster Stelle der ControllerChain der View und hat
+	/// also keinen eigenen Filter; solange er nicht aufzeichnet, ist er in der Kette ausgeschaltet.
+	class EventRecorder : public Controller
+	{
+	public:
+		enum { Magic = 0x47544552, Version = 2 }; // "GTER"; 2..Wheel mit angleDelta, pixelDelta und phase
+		EventRecorder( QWidget* view );
+		~EventRecorder();
+		bool start( const QString& path );
+		void stop();
+		bool isRecording() const { return d_file.isOpen(); }
+		int count() const { return d_count; }
+	protected:
+		//* Calldowns; konsumieren nie
+		bool mouseMoveEvent(QMouseEvent* e) { return record( e ); }
+		bool mousePressEvent(QMouseEvent* e) { return record( e ); }
+		bool mouseReleaseEvent(QMouseEvent* e) { return record( e ); }
+		bool mouseDoubleClickEvent(QMouseEvent* e) { return record( e ); }
+		bool wheelEvent(QWheelEvent* e) { return record( e ); }
+		bool keyPressEvent(QKeyEvent* e) { return record( e ); }
+		bool keyReleaseEvent(QKeyEvent* e) { return record( e ); }
+		bool focusInEvent(QFocusEvent* e) { return record( e ); }
+		bool focusOutEvent(QFocusEvent* e) { return record( e ); }
+		bool enterEvent(QEvent* e) { return record( e ); }
+		bool leaveEvent(QEvent* e) { return record( e ); }
+		bool paintEvent(QPaintEvent* e) { return record( e ); }
+		bool resizeEvent(QResizeEvent* e) { return record( e ); }
+		//-
+		bool record( QEvent* );
+	private:
+		QPointer<ControllerChain> d_host; // kann vor dem Recorder gelöscht werden
+		QFile d_file;
+		QDataStream d_out;
+		QElapsedTimer d_clock;
+		qint64 d_last; // Zeit des letzten Events in us
+		int d_count;
+	};
+
+	/// Spielt eine Aufzeichnung von EventRecorder auf einer View ab, entweder so schnell wie möglich
+	/// oder mit den aufgezeichneten Abständen, und misst pro Event-Typ die Zeit im Handler.
+	/// Bei den aufgezeichneten Abständen wird in einer lokalen Event-Loop mit Timer gewartet.
+	/// Paint-Events werden mit repaint() synchron ausgelöst, damit auch die Frame-Zeit erfasst wird.
+	class EventReplayer
+	{
+	public:
+		struct Stats
+		{
+			int d_count;
+			qint64 d_totalNs;
+			qint64 d_maxNs;
+			Stats():d_count(0),d_totalNs(0),d_maxNs(0) {}
+		};
+		EventReplayer( QWidget* view );
+		bool run( const QString& path, bool realTime = false );
+		const QString& error() const { return d_error; }
+		const QHash<int,Stats>& stats() const { return d_stats; } // QEvent::Type -> Stats
+		qint64 totalNs() const { return d_totalNs; }
+		int count() const { return d_count; }
+		QByteArray toJson() const;
+		void dump() const; // via qDebug
+	private:
+		void send( QEvent* );
+		void account( int type, qint64 ns );
+		QPointer<QWidget> d_view;
+		QHash<int,Stats> d_stats;
+		QString d_error;
+		qint64 d_totalNs;
+		int d_count;
+	};
+}
+
+#endif // _GUI2_EVENTRECORDER
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License (LGPL) as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * You should have received a copy of the LGPL along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LayerCompositor.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <QResizeEvent>
+using namespace Gui;
+
+static inline qreal _ratio( const QWidget* w )
+{
+#if QT_VERSION >= 0x050600
+	return w->devicePixelRatioF();
+#elif QT_VERSION >= 0x050000
+	return w->devicePixelRatio();
+#else
+	Q_UNUSED( w );
+	return 1.0;
+#endif
+}
+
+static inline qreal _ratio( const QImage& img )
+{
+#if QT_VERSION >= 0x050000
+	return img.devicePixelRatio();
+#else
+	Q_UNUSED( img );
+	return 1.0;
+#endif
+}
+
+LayerCompositor::LayerCompositor(QWidget* view):Controller( view, PaintEvents | GeometryEvents )
+{
+	// Alles wird aus den Ebenen gemalt; Qt muss den Hintergrund nicht vorher löschen
+	view->setAttribute( Qt::WA_OpaquePaintEvent );
+}
+
+LayerCompositor::~LayerCompositor()
+{
+	for( int i = 0; i < d_layers.size(); i++ )
+		d_layers[i].d_c->d_compositor = 0;
+}
+
+void LayerCompositor::addLayer(Controller* c)
+{
+	Q_ASSERT( c != 0 && c != this && c->view() == view() );
+	if( c->d_compositor == this )
+		return;
+	if( c->d_compositor )
+		c->d_compositor->removeLayer( c );
+	c->d_compositor = this;
+	Layer l;
+	l.d_c = c;
+	l.d_image = createImage( view()->size() );
+	l.d_dirty = QRegion( view()->rect() );
+	d_layers.append( l );
+	view()->update();
+}
+
+void LayerCompositor::removeLayer(Controller* c)
+{
+	for( int i = 0; i < d_layers.size(); i++ )
+	{
+		if( d_layers[i].d_c == c )
+		{
+			d_layers.removeAt( i );
+			c->d_compositor = 0;
+			view()->update();
+			return;
+		}
+	}
+}
+
+void LayerCompositor::invalidate(Controller* c, const QRect& r)
+{
+	const QRect rect = ( r.isNull() ) ? view()->rect() : r.intersected( view()->rect() );
+	if( rect.isEmpty() )
+		return;
+	for( int i = 0; i < d_layers.size(); i++ )
+	{
+		if( d_layers[i].d_c == c )
+		{
+			d_layers[i].d_dirty += rect;
+			view()->update( rect );
+			return;
+		}
+	}
+}
+
+void LayerCompositor::invalidateAll()
+{
+	for( int i = 0; i < d_layers.size(); i++ )
+		d_layers[i].d_dirty = QRegion( view()->rect() );
+	view()->update();
+}
+
+QImage LayerCompositor::createImage(const QSize& s) const
+{
+	const qreal dpr = _ratio( view() );
+	QImage img( s * dpr, QImage::Format_ARGB32_Premultiplied );
+#if QT_VERSION >= 0x050000
+	img.setDevicePixelRatio( dpr );
+#endif
+	return img;
+}
+
+void LayerCompositor::allocate(const QSize& s)
+{
+	const qreal dpr = _ratio( view() );
+	for( int i = 0; i < d_layers.size(); i++ )
+	{
+		if( d_layers[i].d_image.size() != s * dpr || _ratio( d_layers[i].d_image ) != dpr )
+			d_layers[i].d_image = createImage( s );
+		d_layers[i].d_dirty = QRegion( QRect( QPoint( 0, 0 ), s ) );
+	}
+}
+
+bool LayerCompositor::resizeEvent(QResizeEvent* e)
+{
+	allocate( e->size() );
+	return false; // andere Controller sollen die Grösse auch erfahren
+}
+
+bool LayerCompositor::paintEvent(QPaintEvent* e)
+{
+	// z.B. nachdem das Fenster auf einen Bildschirm mit anderem devicePixelRatio verschoben wurde
+	if( !d_layers.isEmpty() && _ratio( d_layers.first().d_image ) != _ratio( view() ) )
+		allocate( view()->size() );
+	// Zuerst die ungültigen Teile der Ebenen neu malen, und zwar nur diese
+	for( int i = 0; i < d_layers.size(); i++ )
+	{
+		Layer& l = d_layers[i];
+		if( l.d_dirty.isEmpty() )
+			continue;
+		QPainter p( &l.d_image );
+		p.setClipRegion( l.d_dirty );
+		p.setCompositionMode( QPainter::CompositionMode_Source );
+		p.fillRect( l.d_dirty.boundingRect(), Qt::transparent );
+		p.setCompositionMode( QPainter::CompositionMode_SourceOver );
+		const QRect r = l.d_dirty.boundingRect();
+		l.d_dirty = QRegion();
+		l.d_c->paintLayer( p, r );
+	}
+	// Danach die Ebenen im Bereich des Events übereinander legen
+	// Die View ist WA_OpaquePaintEvent; transparente Stellen der untersten Ebene dürfen keine
+	// Löcher hinterlassen, darum zuerst den Hintergrund
+	QPainter p( view() );
+	const QRegion region = e->region();
+#if QT_VERSION >= 0x050800
+	for( QRegion::const_iterator j = region.begin(); j != region.end(); ++j )
+	{
+		const QRect& r = *j;
+#else
+	const QVector<QRect> rects = region.rects();
+	for( int j = 0; j < rects.size(); j++ )
+	{
+		const QRect& r = rects[j];
+#endif
+		p.fillRect( r, view()->palette().window() );
+		for( int i = 0; i < d_layers.size(); i++ )
+		{
+			// Die Quelle ist in Pixeln des Images
+			const qreal dpr = _ratio( d_layers[i].d_image );
+			p.drawImage( QRectF( r ), d_layers[i].d_image,
+						 QRectF( r.x() * dpr, r.y() * dpr, r.width() * dpr, r.height() * dpr ) );
+		}
+	}
+	return true;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License (LGPL) as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * You should have received a copy of the LGPL along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GUI2_LAYERCOMPOSITOR
+#define _GUI2_LAYERCOMPOSITOR
+
+#include <GuiTools/Controller.h>
+#include <QImage>
+#include <QRegion>
+#include <QList>
+
+namespace Gui
+{
+	/// Setzt die View aus zwischengespeicherten Ebenen zusammen. Jeder mit addLayer() registrierte
+	/// Controller malt in paintLayer() in sein eigenes QImage, welches nur neu gemalt wird, soweit es
+	/// der Controller mit invalidateLayer() ungültig erklärt hat. Ein Fadenkreuz, das der Maus folgt,
+	/// malt damit nicht auch noch alle statischen Annotationen neu.
+	/// Der Compositor malt die ganze View und konsumiert den Paint-Event; wo alle Ebenen transparent
+	/// sind, erscheint palette().window(). Die Ebenen haben die Auflösung des Bildschirms
+	/// (devicePixelRatio), paintLayer malt aber in logischen Koordinaten. Er muss nach den anderen Controllern erzeugt werden,
+	/// damit sein Filter zuerst drankommt.
+	class LayerCompositor : public Controller
+	{
+	public:
+		LayerCompositor( QWidget* view );
+		~LayerCompositor();
+
+		void addLayer( Controller* ); // zuoberst
+		void removeLayer( Controller* );
+		int layerCount() const { return d_layers.size(); }
+		void invalidate( Controller*, const QRect& = QRect() ); // leeres Rect..ganze Ebene
+		void invalidateAll();
+	protected:
+		bool paintEvent( QPaintEvent* );
+		bool resizeEvent( QResizeEvent* );
+		void allocate( const QSize& );
+		QImage createImage( const QSize& ) const;
+	private:
+		struct Layer
+		{
+			Controller* d_c;
+			QImage d_image;
+			QRegion d_dirty;
+		};
+		QList<Layer> d_layers;
+	};
+}
+
+#endif // _GUI2_LAYERCOMPOSITOR
@@ -4,13 +4,21 @@ SOURCES += \
 	$$PWD/AutoMenu.cpp \
 	$$PWD/AutoShortcut.cpp \
 	$$PWD/AutoToolBar.cpp \
+	$$PWD/CommandMacro.cpp \
+	$$PWD/CommandPalette.cpp \
+	$$PWD/CommandProfiler.cpp \
 	$$PWD/NamedFunction.cpp \
+	$$PWD/ShortcutDispatcher.cpp \
 	$$PWD/UiFunction.cpp
 
 HEADERS += \
 	$$PWD/AutoMenu.h \
 	$$PWD/AutoShortcut.h \
 	$$PWD/AutoToolBar.h \
+	$$PWD/CommandMacro.h \
+	$$PWD/CommandPalette.h \
+	$$PWD/CommandProfiler.h \
 	$$PWD/NamedFunction.h \
+	$$PWD/ShortcutDispatcher.h \
 	$$PWD/UiFunction.h 
 
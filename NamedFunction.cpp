@@ -19,6 +19,8 @@
  */
 
 #include "NamedFunction.h"
+#include "CommandProfiler.h"
+#include "CommandMacro.h"
 #include <QApplication>
 #include <cassert>
 #include <ctype.h>
@@ -34,6 +36,13 @@ NamedFunction::NamedFunction(const QString& title, const char* slot, QObject *pa
 		d_slot += "()";
 }
 
+QByteArray NamedFunction::commandKey() const
+{
+    QString name = text();
+    name.remove( QChar('&') );
+    return name.toUtf8() + " " + d_slot;
+}
+
 bool NamedFunction::prepareImp( QObject* cur )
 {
     // Rufe auf um Verfügbarkeit abzufragen
@@ -50,11 +59,16 @@ void NamedFunction::prepare()
 {
 	// Wird von aboutToShow() etc. aufgerufen. Sucht entlang der VisualHierarchy nach
 	// UiFunction
-	d_preparing = true;
+    prepareFor( QApplication::focusWidget() );
+}
+
+void NamedFunction::prepareFor(QWidget* cur)
+{
+    CommandProfiler::Scope scope( this, CommandProfiler::Prepare );
+    Context ctx( this, true, cur );
     d_target = 0;
 	setEnabled(false);
 	QObject* prev = 0;
-	QWidget* cur = QApplication::focusWidget();
 //#define Gui2_NamedFunction_SearchAllWayUp
 #ifdef Gui2_NamedFunction_SearchAllWayUp
 	if( cur == 0 )
@@ -84,7 +98,10 @@ void NamedFunction::execute()
     // Hier muss aber zuvor prepare() aufgerufen worden sein, ansonsten target nicht bekannt ist.
     if( d_target )
 	{
-		d_preparing = false;
+        if( CommandMacro::isRecording() && Context::current() == 0 )
+            CommandMacro::recordCommand( this );
+        CommandProfiler::Scope scope( this, CommandProfiler::Execute );
+        Context ctx( this, false );
         // Rufe auf um auszuführen
 		callFunction( d_target );
     }else
@@ -97,7 +114,7 @@ bool NamedFunction::callFunction( QObject* o )
     const int slot = o->metaObject()->indexOfSlot( d_slot );
     if( slot == -1 )
         return false;
-    s_sender = this;
+    // Der Kontext (me(), isPreparing()) wurde bereits von prepare() bzw. execute() gesetzt
 #ifdef __UsingQtPrivate__
     const int sig = metaObject()->indexOfSignal( "handle()" );
     assert( sig != -1 );
@@ -116,6 +133,5 @@ bool NamedFunction::callFunction( QObject* o )
     if( !res )
         qWarning() << "NamedFunction::callFunction failed:" << d_slot;
 #endif
-    s_sender = 0;
     return true;
 }
@@ -36,7 +36,9 @@ namespace Gui
 		// Overrides
 		void prepare(); 
 		void execute(); 
+        void prepareFor( QWidget* focus );
         bool hasTarget() const { return (d_target != 0); }
+        QByteArray commandKey() const;
 	private:
 		QByteArray d_slot;
 		QObject* d_target;
@@ -0,0 +1,344 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * GNU General Public License Usage
+ * This file may be used under the terms of the GNU General Public
+ * License (GPL) versions 2.0 or 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in
+ * the packaging of this file. Please review the following information
+ * to ensure GNU General Public Licensing requirements will be met:
+ * http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+ * http://www.gnu.org/copyleft/gpl.html.
+ */
+
+#include "ShortcutDispatcher.h"
+#include "UiFunction.h"
+#include <QApplication>
+#include <QKeyEvent>
+#include <QWidget>
+#include <QtDebug>
+using namespace Gui;
+
+QHash<QWidget*,ShortcutDispatcher*> ShortcutDispatcher::s_dispatchers;
+ShortcutDispatcher* ShortcutDispatcher::s_pending = 0;
+
+namespace Gui
+{
+// Ein einziger Filter für die ganze Applikation; die Tastendrücke werden vom Fokus-Widget aufwärts
+// an die Dispatcher verteilt.
+// Wie bei QShortcutMap darf das Fokus-Widget eine Taste zuerst mit ShortcutOverride für sich
+// beanspruchen (z.B. Ctrl+C, Delete oder Return in einem QLineEdit); nur wenn es das nicht tut,
+// wird der nachfolgende KeyPress als Shortcut ausgeführt.
+class ShortcutDispatcherFilter : public QObject
+{
+public:
+    ShortcutDispatcherFilter():QObject(qApp),d_overridden(0),d_inOverride(false) {}
+    bool eventFilter( QObject* watched, QEvent* e )
+    {
+        if( ( e->type() != QEvent::KeyPress && e->type() != QEvent::ShortcutOverride ) ||
+                d_inOverride || QApplication::activePopupWidget() != 0 )
+            return false;
+        QWidget* w = qobject_cast<QWidget*>( watched );
+        if( w == 0 || ( QApplication::focusWidget() != 0 && w != QApplication::focusWidget() ) )
+            return false; // Propagation an die Parents ignorieren; wir suchen selber aufwärts
+        QKeyEvent* k = static_cast<QKeyEvent*>( e );
+        if( e->type() == QEvent::ShortcutOverride )
+        {
+            d_overridden = 0;
+            if( !ShortcutDispatcher::lookup( k, w ) )
+                return false;
+            // Das Widget erhält den Override hier selber, damit wir das Resultat kennen
+            d_inOverride = true;
+            e->ignore();
+            QApplication::sendEvent( w, e );
+            d_inOverride = false;
+            if( e->isAccepted() )
+                d_overridden = ShortcutDispatcher::keyOf( k );
+            return true;
+        }
+        if( d_overridden != 0 )
+        {
+            const bool overridden = d_overridden == ShortcutDispatcher::keyOf( k );
+            d_overridden = 0;
+            if( overridden )
+                return false; // das Widget hat die Taste beansprucht
+        }
+        return ShortcutDispatcher::handleKey( k, w );
+    }
+private:
+    int d_overridden; // vom Fokus-Widget beanspruchte Taste
+    bool d_inOverride;
+};
+}
+
+ShortcutDispatcher::ShortcutDispatcher(QWidget* window):QObject(window),d_window(window),d_state(0)
+{
+    static ShortcutDispatcherFilter* s_filter = 0;
+    if( s_filter == 0 )
+    {
+        s_filter = new ShortcutDispatcherFilter();
+        qApp->installEventFilter( s_filter );
+    }
+    d_nodes.append( Node() );
+    s_dispatchers[window] = this;
+}
+
+ShortcutDispatcher::~ShortcutDispatcher()
+{
+    s_dispatchers.remove( d_window );
+    if( s_pending == this )
+        s_pending = 0;
+}
+
+ShortcutDispatcher* ShortcutDispatcher::get(QWidget* host)
+{
+    Q_ASSERT( host != 0 );
+    // Wird der host später in ein anderes Fenster verschoben, bleibt der Dispatcher beim bisherigen
+    // Top-Level; handleKey sucht deshalb alle Vorfahren des Fokus-Widgets ab.
+    QWidget* w = host->window();
+    ShortcutDispatcher* d = s_dispatchers.value( w );
+    if( d == 0 )
+        d = new ShortcutDispatcher( w );
+    return d;
+}
+
+bool ShortcutDispatcher::add(const QKeySequence& s, QWidget* host, UiFunction* f, bool autoRepeat)
+{
+    Binding b;
+    b.d_host = host;
+    b.d_f = f;
+    b.d_autoRepeat = autoRepeat;
+    return add( s, b );
+}
+
+bool ShortcutDispatcher::add(const QKeySequence& s, QWidget* host, QObject* owner, Provider* p, int cookie)
+{
+    Q_ASSERT( owner != 0 && p != 0 );
+    Binding b;
+    b.d_host = host;
+    b.d_owner = owner;
+    b.d_provider = p;
+    b.d_cookie = cookie;
+    return add( s, b );
+}
+
+void ShortcutDispatcher::remove(const QKeySequence& s, UiFunction* f)
+{
+    int node = 0;
+    for( int i = 0; i < int(s.count()) && node != -1; i++ )
+        node = d_nodes[node].d_next.value( s[i], -1 );
+    if( node <= 0 )
+        return;
+    // Der Knoten selber bleibt; leere Knoten stören dispatch nicht
+    QList<Binding>& l = d_nodes[node].d_bindings;
+    for( int j = l.size() - 1; j >= 0; j-- )
+    {
+        if( l[j].d_f == f )
+            l.removeAt( j );
+    }
+    if( d_state == node )
+        d_state = 0;
+}
+
+bool ShortcutDispatcher::overlaps(QWidget* a, QWidget* b)
+{
+    return a == b || a->isAncestorOf( b ) || b->isAncestorOf( a );
+}
+
+bool ShortcutDispatcher::conflictsBelow(int node, QWidget* host) const
+{
+    const Node& n = d_nodes[node];
+    QHash<int,int>::const_iterator i;
+    for( i = n.d_next.begin(); i != n.d_next.end(); ++i )
+    {
+        const Node& c = d_nodes[i.value()];
+        for( int j = 0; j < c.d_bindings.size(); j++ )
+        {
+            if( c.d_bindings[j].isAlive() && overlaps( c.d_bindings[j].d_host, host ) )
+                return true;
+        }
+        if( conflictsBelow( i.value(), host ) )
+            return true;
+    }
+    return false;
+}
+
+bool ShortcutDispatcher::appliesBelow(int node, QWidget* focus) const
+{
+    const Node& n = d_nodes[node];
+    QHash<int,int>::const_iterator i;
+    for( i = n.d_next.begin(); i != n.d_next.end(); ++i )
+    {
+        const Node& c = d_nodes[i.value()];
+        for( int j = 0; j < c.d_bindings.size(); j++ )
+        {
+            QWidget* host = c.d_bindings[j].d_host;
+            if( c.d_bindings[j].isAlive() && ( host == focus || host->isAncestorOf( focus ) ) )
+                return true;
+        }
+        if( appliesBelow( i.value(), focus ) )
+            return true;
+    }
+    return false;
+}
+
+bool ShortcutDispatcher::add(const QKeySequence& s, const Binding& b)
+{
+    if( s.isEmpty() || b.d_host.isNull() )
+        return true;
+    bool ok = true;
+    int node = 0;
+    for( int i = 0; i < int(s.count()); i++ )
+    {
+        // Eine bereits vergebene kürzere Folge eines überlappenden host verdeckt die neue Folge
+        const QList<Binding>& prefix = d_nodes[node].d_bindings;
+        for( int j = 0; j < prefix.size(); j++ )
+        {
+            if( prefix[j].isAlive() && overlaps( prefix[j].d_host, b.d_host ) )
+                ok = false;
+        }
+        int next = d_nodes[node].d_next.value( s[i], 0 );
+        if( next == 0 )
+        {
+            d_nodes.append( Node() );
+            next = d_nodes.size() - 1;
+            d_nodes[node].d_next[ s[i] ] = next;
+        }
+        node = next;
+    }
+    QList<Binding>& l = d_nodes[node].d_bindings;
+    for( int j = l.size() - 1; j >= 0; j-- )
+    {
+        if( !l[j].isAlive() )
+            l.removeAt( j );
+        else if( l[j].d_host == b.d_host )
+            ok = false; // Ein host mit derselben Folge für zwei Befehle
+    }
+    if( conflictsBelow( node, b.d_host ) )
+        ok = false;
+    l.append( b );
+    if( !ok )
+        qWarning() << "ShortcutDispatcher: ambiguous shortcut" << s.toString() << "on" << b.d_host.data();
+    return ok;
+}
+
+ShortcutDispatcher::Result ShortcutDispatcher::dispatch(int key, QWidget* focus, bool repeated)
+{
+    const int next = d_nodes[d_state].d_next.value( key, 0 );
+    d_state = 0;
+    if( next == 0 )
+        return NoMatch;
+    // Gehe vom Fokus-Widget aufwärts, damit der nächstgelegene host gewinnt
+    for( QWidget* w = focus; w != 0; w = w->parentWidget() )
+    {
+        QList<Binding>& l = d_nodes[next].d_bindings;
+        for( int i = 0; i < l.size(); i++ )
+        {
+            if( l[i].d_host != w || !w->isEnabled() )
+                continue;
+            if( l[i].d_f.isNull() && !l[i].d_owner.isNull() )
+                l[i].d_f = l[i].d_provider->provide( l[i].d_cookie );
+            UiFunction* f = l[i].d_f;
+            if( f == 0 )
+                continue;
+            if( repeated && !l[i].d_autoRepeat )
+                return Executed;
+            // Vorsicht: execute kann neue Einträge registrieren oder diesen Dispatcher löschen
+            f->prepare();
+            if( f->isEnabled() )
+                f->execute();
+            return Executed;
+        }
+        if( w->isWindow() )
+            break;
+    }
+    if( appliesBelow( next, focus ) )
+    {
+        d_state = next;
+        return Partial;
+    }
+    return NoMatch;
+}
+
+bool ShortcutDispatcher::matches(int key, QWidget* focus) const
+{
+    const int next = d_nodes[d_state].d_next.value( key, 0 );
+    if( next == 0 )
+        return false;
+    const QList<Binding>& l = d_nodes[next].d_bindings;
+    for( int i = 0; i < l.size(); i++ )
+    {
+        QWidget* host = l[i].d_host;
+        if( l[i].isAlive() && host->isEnabled() && ( host == focus || host->isAncestorOf( focus ) ) )
+            return true;
+    }
+    return appliesBelow( next, focus );
+}
+
+int ShortcutDispatcher::keyOf(QKeyEvent* e)
+{
+    const int k = e->key();
+    if( k == Qt::Key_Shift || k == Qt::Key_Control || k == Qt::Key_Alt || k == Qt::Key_Meta ||
+            k == Qt::Key_AltGr || k == Qt::Key_unknown || k == 0 )
+        return 0;
+    return k | int( e->modifiers() &
+                    ( Qt::ShiftModifier | Qt::ControlModifier | Qt::AltModifier | Qt::MetaModifier ) );
+}
+
+bool ShortcutDispatcher::lookup(QKeyEvent* e, QWidget* focus)
+{
+    const int key = keyOf( e );
+    // Wie bei QShortcutMap kann eine angefangene Folge nicht mehr überschrieben werden
+    if( key == 0 || s_pending != 0 )
+        return false;
+    for( QWidget* w = focus; w != 0; w = w->parentWidget() )
+    {
+        ShortcutDispatcher* d = s_dispatchers.value( w );
+        if( d && d->matches( key, focus ) )
+            return true;
+        if( w->isWindow() )
+            break;
+    }
+    return false;
+}
+
+bool ShortcutDispatcher::handleKey(QKeyEvent* e, QWidget* focus)
+{
+    const int key = keyOf( e );
+    if( key == 0 )
+        return false;
+    if( s_pending )
+    {
+        // Eine Teilfolge wurde bereits eingegeben
+        ShortcutDispatcher* d = s_pending;
+        s_pending = 0;
+        const Result r = d->dispatch( key, focus, e->isAutoRepeat() );
+        if( r == Partial )
+            s_pending = d;
+        if( r != NoMatch )
+            return true;
+        // sonst wie Qt nochmals ab der Wurzel versuchen
+    }
+    for( QWidget* w = focus; w != 0; w = w->parentWidget() )
+    {
+        ShortcutDispatcher* d = s_dispatchers.value( w );
+        if( d )
+        {
+            const Result r = d->dispatch( key, focus, e->isAutoRepeat() );
+            if( r == Partial )
+                s_pending = d;
+            if( r != NoMatch )
+                return true;
+        }
+        if( w->isWindow() )
+            break;
+    }
+    return false;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * GNU General Public License Usage
+ * This file may be used under the terms of the GNU General Public
+ * License (GPL) versions 2.0 or 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in
+ * the packaging of this file. Please review the following information
+ * to ensure GNU General Public Licensing requirements will be met:
+ * http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+ * http://www.gnu.org/copyleft/gpl.html.
+ */
+
+#ifndef _Gui2_ShortcutDispatcher
+#define _Gui2_ShortcutDispatcher
+
+#include <QObject>
+#include <QKeySequence>
+#include <QPointer>
+#include <QVector>
+#include <QHash>
+#include <QList>
+
+class QKeyEvent;
+
+namespace Gui
+{
+	class UiFunction;
+
+    // Zentrale Verteilung der Shortcuts von UiFunctions; ersetzt einen QShortcut pro Befehl.
+    // Pro Top-Level-Fenster gibt es eine Instanz, welche die Tastenfolgen in einem Trie hält, so dass
+    // ein Tastendruck in O(Länge der Folge) aufgelöst wird. Wie bei Qt::WidgetWithChildrenShortcut ist
+    // ein Eintrag nur aktiv, wenn der Fokus auf dem host oder einem seiner Children liegt; bei mehreren
+    // passenden Einträgen gewinnt der host, der dem Fokus-Widget am nächsten ist.
+	class ShortcutDispatcher : public QObject
+	{
+	public:
+        // Für Befehle, deren UiFunction erst bei Bedarf erzeugt wird (siehe AutoMenu::addCommands).
+        class Provider
+        {
+        public:
+            virtual UiFunction* provide( int cookie ) = 0;
+        protected:
+            ~Provider() {}
+        };
+
+        static ShortcutDispatcher* get( QWidget* host ); // Instanz des aktuellen Fensters von host
+
+        // Gibt false zurück, wenn die Folge mit einem bestehenden Eintrag kollidiert; dieser wird
+        // trotzdem registriert, aber die Kollision wird hier und nicht erst beim Tastendruck gemeldet.
+        // Mit autoRepeat false wird eine wiederholte Taste geschluckt statt ausgeführt.
+        bool add( const QKeySequence&, QWidget* host, UiFunction*, bool autoRepeat = true );
+        bool add( const QKeySequence&, QWidget* host, QObject* owner, Provider*, int cookie );
+        void remove( const QKeySequence&, UiFunction* );
+
+        ~ShortcutDispatcher();
+	protected:
+        struct Binding
+        {
+            QPointer<QWidget> d_host;
+            QPointer<UiFunction> d_f;
+            QPointer<QObject> d_owner;
+            Provider* d_provider;
+            int d_cookie;
+            bool d_autoRepeat;
+            Binding():d_provider(0),d_cookie(-1),d_autoRepeat(true) {}
+            bool isAlive() const { return !d_host.isNull() && ( !d_f.isNull() || !d_owner.isNull() ); }
+        };
+        struct Node
+        {
+            QHash<int,int> d_next; // key -> Index in d_nodes
+            QList<Binding> d_bindings;
+        };
+        enum Result { NoMatch, Partial, Executed };
+        Result dispatch( int key, QWidget* focus, bool repeated );
+        bool matches( int key, QWidget* focus ) const; // wie dispatch, aber ohne Ausführung
+        bool add( const QKeySequence&, const Binding& );
+        bool conflictsBelow( int node, QWidget* host ) const;
+        bool appliesBelow( int node, QWidget* focus ) const;
+        static bool overlaps( QWidget* a, QWidget* b );
+        static bool handleKey( QKeyEvent*, QWidget* focus );
+        static bool lookup( QKeyEvent*, QWidget* focus ); // für ShortcutOverride
+        static int keyOf( QKeyEvent* ); // 0 für Modifier allein
+        friend class ShortcutDispatcherFilter;
+	private:
+        ShortcutDispatcher( QWidget* window );
+        QVector<Node> d_nodes; // d_nodes[0] ist die Wurzel
+        QWidget* d_window;
+        int d_state; // Knoten der bisher eingegebenen Teilfolge oder 0
+        static QHash<QWidget*,ShortcutDispatcher*> s_dispatchers;
+        static ShortcutDispatcher* s_pending;
+	};
+}
+
+#endif // _Gui2_ShortcutDispatcher
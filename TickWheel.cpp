@@ -0,0 +1,197 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License (LGPL) as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * You should have received a copy of the LGPL along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TickWheel.h"
+#include "Controller.h"
+#include <QCoreApplication>
+#include <QTimerEvent>
+using namespace Gui;
+
+TickWheel* TickWheel::s_inst = 0;
+
+TickWheel* TickWheel::instance()
+{
+	if( s_inst == 0 )
+		s_inst = new TickWheel();
+	return s_inst;
+}
+
+TickWheel::TickWheel():QObject( qApp ),d_now(0),d_due(0),d_nextId(-1)
+{
+	d_level0.resize( Level0 );
+	d_level1.resize( Level1 );
+	d_clock.start();
+}
+
+TickWheel::~TickWheel()
+{
+	qDeleteAll( d_entries );
+	s_inst = 0;
+}
+
+int TickWheel::start(Controller* c, int ms, bool singleShot)
+{
+	Q_ASSERT( c != 0 );
+	if( d_entries.isEmpty() )
+		d_now = now(); // Nach einer Pause gibt es nichts nachzuholen
+	Entry* e = new Entry();
+	e->d_c = c;
+	e->d_id = d_nextId--;
+	if( d_nextId > 0 )
+		d_nextId = -1; // Überlauf
+	e->d_interval = qMax( qint64( 1 ), qint64( ( ms + Resolution - 1 ) / Resolution ) );
+	// d_now kann zurückliegen, da der Timer nur für belegte Slots läuft
+	e->d_expires = now() + e->d_interval;
+	e->d_slot = 0;
+	e->d_singleShot = singleShot;
+	schedule( e );
+	d_entries.insert( e->d_id, e );
+	d_byController.insert( c, e->d_id );
+	if( !d_timer.isActive() || e->d_expires < d_due )
+		rearm();
+	return e->d_id;
+}
+
+void TickWheel::stop(int id)
+{
+	Entry* e = d_entries.take( id );
+	if( e == 0 )
+		return;
+	unlink( e );
+	d_byController.remove( e->d_c, id );
+	delete e;
+	if( d_entries.isEmpty() )
+		d_timer.stop();
+}
+
+void TickWheel::stopAll(Controller* c)
+{
+	const QList<int> ids = d_byController.values( c );
+	foreach( int id, ids )
+		stop( id );
+}
+
+void TickWheel::schedule(Entry* e)
+{
+	const qint64 delta = e->d_expires - d_now;
+	if( delta < Level0 )
+		e->d_slot = &d_level0[ e->d_expires % Level0 ];
+	else if( delta < Level0 * Level1 )
+		e->d_slot = &d_level1[ ( e->d_expires / Level0 ) % Level1 ];
+	else
+		e->d_slot = &d_overflow;
+	e->d_slot->append( e );
+}
+
+void TickWheel::unlink(Entry* e)
+{
+	if( e->d_slot )
+		e->d_slot->removeOne( e );
+	e->d_slot = 0;
+}
+
+void TickWheel::cascade(QList<Entry*>& l)
+{
+	const QList<Entry*> tmp = l;
+	l.clear();
+	foreach( Entry* e, tmp )
+		schedule( e );
+}
+
+void TickWheel::advance(qint64 to, QList<int>& due)
+{
+	while( d_now < to )
+	{
+		d_now++;
+		const int i0 = d_now % Level0;
+		if( i0 == 0 )
+		{
+			// Die nächsten Level0 Ticks aus der zweiten Stufe herunterholen
+			const int i1 = ( d_now / Level0 ) % Level1;
+			if( i1 == 0 )
+				cascade( d_overflow );
+			cascade( d_level1[i1] );
+		}
+		QList<Entry*>& slot = d_level0[i0];
+		for( int i = 0; i < slot.size(); i++ )
+		{
+			Q_ASSERT( slot[i]->d_expires == d_now );
+			slot[i]->d_slot = 0;
+			due.append( slot[i]->d_id );
+		}
+		slot.clear();
+	}
+}
+
+void TickWheel::rearm()
+{
+	if( d_entries.isEmpty() )
+	{
+		d_timer.stop();
+		return;
+	}
+	// Spätestens beim nächsten Umlauf der ersten Stufe muss die zweite heruntergeholt werden
+	const qint64 bound = ( d_now / Level0 + 1 ) * Level0;
+	qint64 next = d_now + 1;
+	while( next < bound && d_level0[ next % Level0 ].isEmpty() )
+		next++;
+	if( d_timer.isActive() && next == d_due )
+		return;
+	d_due = next;
+	const qint64 ms = next * Resolution - d_clock.elapsed();
+	d_timer.start( int( qMax( qint64( 0 ), ms ) ), this );
+}
+
+void TickWheel::timerEvent(QTimerEvent* te)
+{
+	if( te->timerId() != d_timer.timerId() )
+	{
+		QObject::timerEvent( te );
+		return;
+	}
+	QList<int> due;
+	advance( now(), due );
+	// Ein Calldown kann Ticks starten, stoppen oder Controller löschen; darum über die ids gehen
+	foreach( int id, due )
+	{
+		Entry* e = d_entries.value( id );
+		if( e == 0 || e->d_slot != 0 )
+			continue; // inzwischen gestoppt oder neu eingeplant
+		Controller* c = e->d_c;
+		const bool visible = c->view()->isVisible();
+		if( e->d_singleShot )
+		{
+			d_entries.remove( id );
+			d_byController.remove( c, id );
+			delete e;
+		}else
+		{
+			e->d_expires += e->d_interval;
+			if( e->d_expires <= d_now )
+				e->d_expires = d_now + e->d_interval; // verpasste Ticks nicht nachliefern
+			schedule( e );
+			if( !visible )
+				continue;
+		}
+		QTimerEvent ev( id );
+		c->tickEvent( &ev );
+	}
+	d_timer.stop(); // d_due ist abgelaufen
+	rearm();
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License (LGPL) as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * You should have received a copy of the LGPL along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GUI2_TICKWHEEL
+#define _GUI2_TICKWHEEL
+
+#include <QObject>
+#include <QBasicTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QVector>
+
+namespace Gui
+{
+	class Controller;
+
+	/// Gemeinsamer, hierarchischer Timer für Controller::tickEvent. Alle Registrierungen laufen
+	/// über einen einzigen QBasicTimer mit Auflösung Resolution ms; die fälligen Ticks werden pro
+	/// Umlauf gesammelt ausgeliefert. Der Timer wird jeweils auf den nächsten belegten Slot der ersten
+	/// Stufe gestellt (bzw. auf deren nächsten Umlauf) und tickt nicht, solange nichts fällig ist. Die erste Stufe deckt Level0 Ticks ab, die zweite Level0 * Level1,
+	/// was darüber liegt, wird bei jedem Umlauf der zweiten Stufe neu einsortiert.
+	/// Periodische Ticks von Controllern mit unsichtbarer View werden übersprungen.
+	/// Die ids sind negativ, damit sie in tickEvent nicht mit QObject-Timern verwechselt werden.
+	class TickWheel : public QObject
+	{
+	public:
+		enum { Resolution = 10, Level0 = 256, Level1 = 64 };
+		static TickWheel* instance();
+		static bool exists() { return s_inst != 0; }
+
+		int start( Controller*, int ms, bool singleShot );
+		void stop( int id );
+		void stopAll( Controller* );
+		int count() const { return d_entries.size(); }
+	protected:
+		void timerEvent( QTimerEvent* );
+	private:
+		TickWheel();
+		~TickWheel();
+		struct Entry
+		{
+			Controller* d_c;
+			int d_id;
+			qint64 d_interval; // in Ticks
+			qint64 d_expires; // absoluter Tick
+			QList<Entry*>* d_slot; // aktuelle Liste, in welcher der Eintrag hängt
+			bool d_singleShot;
+		};
+		void schedule( Entry* );
+		void unlink( Entry* );
+		void advance( qint64 to, QList<int>& due );
+		void cascade( QList<Entry*>& );
+		void rearm();
+		qint64 now() const { return d_clock.elapsed() / Resolution; }
+
+		QVector< QList<Entry*> > d_level0;
+		QVector< QList<Entry*> > d_level1;
+		QList<Entry*> d_overflow;
+		QHash<int,Entry*> d_entries;
+		QMultiHash<Controller*,int> d_byController;
+		QBasicTimer d_timer;
+		QElapsedTimer d_clock;
+		qint64 d_now; // zuletzt verarbeiteter Tick
+		qint64 d_due; // Tick, auf den d_timer gestellt ist
+		int d_nextId;
+		static TickWheel* s_inst;
+	};
+}
+
+#endif // _GUI2_TICKWHEEL
@@ -19,14 +19,140 @@
  */
 
 #include "UiFunction.h"
+#include "CommandProfiler.h"
+#include "CommandMacro.h"
 #include <QEvent>
+#include <QApplication>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QThreadStorage>
+#include <QThread>
 using namespace Gui;
- 
+
 UiFunction* UiFunction::s_sender = 0;
 bool UiFunction::d_preparing = false;
 
+static inline bool _isGuiThread()
+{
+    return QCoreApplication::instance() != 0 && QThread::currentThread() == QCoreApplication::instance()->thread();
+}
+
+struct ContextStack
+{
+    UiFunction::Context* d_top;
+    ContextStack():d_top(0) {}
+};
+static QThreadStorage<ContextStack*> s_contexts; // Qt4 verlangt hier einen Pointer
+
+static inline ContextStack* _stack()
+{
+    if( !s_contexts.hasLocalData() )
+        s_contexts.setLocalData( new ContextStack() );
+    return s_contexts.localData();
+}
+
+UiFunction::Context::Context(UiFunction* f, bool preparing, QWidget* target):
+    d_f(f),d_target(target),d_preparing(preparing),d_oldSender(0),d_oldPreparing(false)
+{
+    ContextStack* s = _stack();
+    d_outer = s->d_top;
+    s->d_top = this;
+    if( _isGuiThread() )
+    {
+        // für alten Code, der noch die statischen Variablen liest
+        d_oldSender = UiFunction::s_sender;
+        d_oldPreparing = UiFunction::d_preparing;
+        UiFunction::s_sender = f;
+        UiFunction::d_preparing = preparing;
+    }
+}
+
+UiFunction::Context::~Context()
+{
+    ContextStack* s = _stack();
+    Q_ASSERT( s->d_top == this );
+    s->d_top = d_outer;
+    if( _isGuiThread() )
+    {
+        UiFunction::s_sender = d_oldSender;
+        UiFunction::d_preparing = d_oldPreparing;
+    }
+}
+
+UiFunction::Context* UiFunction::Context::current()
+{
+    return _stack()->d_top;
+}
+
+UiFunction* UiFunction::me()
+{
+    Context* c = Context::current();
+    return ( c ) ? c->d_f : 0;
+}
+
+bool UiFunction::isPreparing() const
+{
+    Context* c = Context::current();
+    return c != 0 && c->d_f == this && c->d_preparing;
+}
+
+static const QEvent::Type s_asyncResult = QEvent::Type( QEvent::registerEventType() );
+
+class AsyncResultEvent : public QEvent
+{
+public:
+    AsyncResultEvent( quint32 gen, bool res ):QEvent(s_asyncResult),d_gen(gen),d_res(res) {}
+    quint32 d_gen;
+    bool d_res;
+};
+
+namespace Gui
+{
+// Gehört gemeinsam der UiFunction und dem Worker; wer zuletzt release() aufruft, löscht den Job.
+class AsyncConditionJob : public QRunnable
+{
+public:
+    AsyncConditionJob( UiFunction* f, AsyncCondition* c, quint32 gen ):d_f(f),d_cond(c),d_ref(2),d_gen(gen)
+    {
+        setAutoDelete( false );
+    }
+    ~AsyncConditionJob()
+    {
+        delete d_cond;
+    }
+    void run()
+    {
+        const bool res = d_cond->evaluate();
+        {
+            QMutexLocker lock( &d_lock );
+            if( d_f )
+                QCoreApplication::postEvent( d_f, new AsyncResultEvent( d_gen, res ) );
+        }
+        release();
+    }
+    void detach()
+    {
+        QMutexLocker lock( &d_lock );
+        d_f = 0;
+    }
+    void release()
+    {
+        if( !d_ref.deref() )
+            delete this;
+    }
+private:
+    QMutex d_lock;
+    UiFunction* d_f; // 0 sobald die UiFunction das Resultat nicht mehr will
+    AsyncCondition* d_cond;
+    QAtomicInt d_ref;
+    quint32 d_gen;
+};
+}
+
 UiFunction::UiFunction(QObject *parent)
-	: QAction(parent)
+	: QAction(parent),d_member(0),d_stats(0),d_job(0),d_jobTarget(0),d_asyncGen(0)
 {
     connect( this, SIGNAL( triggered( bool ) ), this, SLOT( execute() ) );
     setEnabled(true);
@@ -34,7 +160,7 @@ UiFunction::UiFunction(QObject *parent)
 }
 
 UiFunction::UiFunction(const QString& text, QObject *parent)
-	: QAction(text,parent)
+	: QAction(text,parent),d_member(0),d_stats(0),d_job(0),d_jobTarget(0),d_asyncGen(0)
 {
     connect( this, SIGNAL( triggered( bool ) ), this, SLOT( execute() ) );
     setEnabled(true);
@@ -42,7 +168,7 @@ UiFunction::UiFunction(const QString& text, QObject *parent)
 }
 
 UiFunction::UiFunction(const QString& text, QObject *parent, QObject *receiver, const char* member)
-	: QAction(text,parent)
+	: QAction(text,parent),d_member(member),d_stats(0),d_job(0),d_jobTarget(0),d_asyncGen(0)
 {
     connect( this, SIGNAL( triggered( bool ) ), this, SLOT( execute() ) );
     connect( this, SIGNAL( handle() ), receiver, member );
@@ -52,25 +178,115 @@ UiFunction::UiFunction(const QString& text, QObject *parent, QObject *receiver,
 
 UiFunction::~UiFunction()
 {
+    cancelAsync();
+}
 
+QByteArray UiFunction::commandKey() const
+{
+    QString name = text();
+    name.remove( QChar('&') );
+    if( name.isEmpty() )
+        name = metaObject()->className();
+    QByteArray key = name.toUtf8();
+    if( d_member != 0 && *d_member != 0 )
+        key += " " + QByteArray( d_member + 1 ); // ohne den Code von SLOT()
+    return key;
 }
 
 void UiFunction::prepare()
 {
-	d_preparing = true;
-	s_sender = this;
+    prepareFor( QApplication::focusWidget() );
+}
+
+void UiFunction::prepareFor(QWidget* focus)
+{
+    CommandProfiler::Scope scope( this, CommandProfiler::Prepare );
+    Context ctx( this, true, focus );
     setEnabled( false );
 	emit handle();
-	s_sender = 0;
 }
 
 void UiFunction::execute()
 {
     // ENABLED_IF lässt in jedem Fall nur durch, wenn Condition erfüllt, auch wenn vorher kein prepare() aufgerufen
-	d_preparing = false;
-	s_sender = this;
+    if( CommandMacro::isRecording() && Context::current() == 0 )
+        CommandMacro::recordCommand( this ); // nur vom Benutzer ausgelöste, nicht verschachtelte Aufrufe
+    CommandProfiler::Scope scope( this, CommandProfiler::Execute );
+    Context ctx( this, false );
 	emit handle();
-	s_sender = 0;
+}
+
+void UiFunction::prepareAsync(AsyncCondition* cond, QWidget* target)
+{
+    Q_ASSERT( cond != 0 );
+    setEnabled( d_asyncStates.value( target, false ) );
+    if( d_job != 0 && d_jobTarget == target )
+    {
+        // Die laufende Auswertung gilt noch; nicht für jeden AutoToolBar-Tick eine neue starten.
+        delete cond;
+        return;
+    }
+    cancelAsync();
+    d_jobTarget = target;
+    if( target )
+        connect( target, SIGNAL( destroyed( QObject* ) ), this, SLOT( onTargetDestroyed( QObject* ) ),
+                 Qt::UniqueConnection );
+    // Wechselt der Fokus, gilt das Resultat für ein anderes Ziel als das, welches prepare wollte
+    connect( qApp, SIGNAL( focusChanged( QWidget*, QWidget* ) ), this, SLOT( onFocusChanged() ),
+             Qt::UniqueConnection );
+    d_job = new AsyncConditionJob( this, cond, ++d_asyncGen );
+    QThreadPool::globalInstance()->start( d_job );
+}
+
+bool UiFunction::evaluate(AsyncCondition* cond)
+{
+    Q_ASSERT( cond != 0 );
+    const bool res = cond->evaluate();
+    delete cond;
+    return res;
+}
+
+void UiFunction::cancelAsync()
+{
+    if( d_job == 0 )
+        return;
+    d_job->detach();
+    d_job->release();
+    d_job = 0;
+    d_asyncGen++; // ein bereits gepostetes Resultat wird damit ignoriert
+    disconnect( qApp, SIGNAL( focusChanged( QWidget*, QWidget* ) ), this, SLOT( onFocusChanged() ) );
+}
+
+void UiFunction::onFocusChanged()
+{
+    cancelAsync();
+}
+
+void UiFunction::onTargetDestroyed(QObject* o)
+{
+    // o wird nur als Schlüssel verwendet
+    d_asyncStates.remove( o );
+    if( o == d_jobTarget )
+        cancelAsync();
+}
+
+bool UiFunction::event(QEvent* e)
+{
+    if( e->type() == s_asyncResult )
+    {
+        AsyncResultEvent* r = static_cast<AsyncResultEvent*>( e );
+        if( r->d_gen != d_asyncGen || d_job == 0 )
+            return true; // veraltet
+        d_job->release();
+        d_job = 0;
+        disconnect( qApp, SIGNAL( focusChanged( QWidget*, QWidget* ) ), this, SLOT( onFocusChanged() ) );
+        // Ein Job für ein anderes target oder ein Fokuswechsel hätte diesen abgebrochen; d_jobTarget ist
+        // also das zuletzt vorbereitete und noch existierende Ziel.
+        d_asyncStates[d_jobTarget] = r->d_res;
+        setEnabled( r->d_res );
+        return true;
+    }else
+        return QAction::event( e );
 }
 
 // QEvent::Shortcut muss hier nicht überschrieben werden, da die Default-Version lediglich triggered(bool) aufruft.
@@ -23,9 +23,24 @@
 
 #include <QAction>
 #include <QUuid>
+#include <QPointer>
+#include <QHash>
 
 namespace Gui
 {
+    class AsyncConditionJob;
+    struct CommandStats;
+
+    // Bedingung für ENABLED_IF_ASYNC. evaluate() läuft in einem Worker-Thread und darf deshalb weder
+    // Widgets noch andere GUI-Objekte anfassen; die benötigten Daten (z.B. ein Pfad) werden bei der
+    // Konstruktion kopiert.
+    class AsyncCondition
+    {
+    public:
+        virtual ~AsyncCondition() {}
+        virtual bool evaluate() = 0;
+    };
+
 	class UiFunction : public QAction
 	{
 		Q_OBJECT
@@ -35,17 +50,63 @@ namespace Gui
         UiFunction( const QString& text, QObject *parent, QObject *receiver, const char* member);
 		~UiFunction();
 
-		bool isPreparing() const { return d_preparing; }
+        // Eintrag im Kontext-Stack des aktuellen Threads, den prepare und execute auf dem Stack anlegen.
+        // Verschachtelte Aufrufe (z.B. ein Menü in der Event-Loop eines Dialogs, der aus execute
+        // geöffnet wurde) überschreiben damit den äusseren Kontext nicht mehr.
+        class Context
+        {
+        public:
+            Context( UiFunction*, bool preparing, QWidget* target = 0 );
+            ~Context();
+            static Context* current(); // innerster Kontext des aktuellen Threads oder 0
+            UiFunction* d_f;
+            Context* d_outer;
+            QWidget* d_target; // Widget, für welches prepareFor aufgerufen wurde
+            bool d_preparing;
+        private:
+            UiFunction* d_oldSender;
+            bool d_oldPreparing;
+            Context( const Context& );
+            Context& operator=( const Context& );
+        };
+
+		bool isPreparing() const; // true, wenn der innerste Kontext ein prepare dieser Funktion ist
         virtual bool hasTarget() const { return true; }
-		static UiFunction* me() { return s_sender; } // RISK: nicht thread-safe
+		static UiFunction* me(); // Funktion des innersten Kontexts; thread-lokal
+
+        // Setzt sofort den zuletzt für target bekannten Zustand und wertet die Bedingung im Hintergrund
+        // aus; das Resultat wird verworfen, wenn inzwischen für ein anderes target vorbereitet wurde.
+        // Übernimmt cond.
+        void prepareAsync( AsyncCondition* cond, QWidget* target );
+        // Wie prepare(), aber als ob focus das Fokus-Widget wäre (z.B. während ein Popup den Fokus hat)
+        virtual void prepareFor( QWidget* focus );
+        static bool evaluate( AsyncCondition* cond ); // synchron, für execute; löscht cond
 	signals:
 		void handle();
 	public slots:
 		virtual void prepare(); // Aktualisiert enabled und checked
 		virtual void execute(); // Führt die Funktion aus
 	protected:
-		static UiFunction* s_sender;
-		static bool d_preparing;
+        bool event( QEvent* );
+        void cancelAsync();
+        // Veraltet: nur noch aus Kompatibilität; spiegeln den innersten Kontext des GUI-Threads.
+        // Schreiben hat keine Wirkung mehr auf me() und isPreparing(); stattdessen Context verwenden.
+        static UiFunction* s_sender;
+        static bool d_preparing;
+        // Name, unter dem CommandProfiler die Messwerte zusammenfasst; alle Instanzen mit demselben
+        // Text und Slot (z.B. die Einträge wiederholt erzeugter Kontextmenüs) teilen sich eine Zeile.
+        virtual QByteArray commandKey() const;
+	private slots:
+        void onFocusChanged();
+        void onTargetDestroyed( QObject* );
+	private:
+        friend class CommandProfiler;
+        const char* d_member; // aus dem Konstruktor, nur für commandKey
+        CommandStats* d_stats; // von CommandProfiler beim ersten Messwert gesetzt, sonst 0
+        AsyncConditionJob* d_job; // laufende Auswertung von ENABLED_IF_ASYNC oder 0
+        QObject* d_jobTarget; // nur als Schlüssel, wird nie dereferenziert
+        QHash<QObject*,bool> d_asyncStates; // letztes Resultat pro target, bis dieses gelöscht wird
+        quint32 d_asyncGen;
 	};
 	// Die folgenden Makros funktionieren sowohl bei Aufruf des Slots via UiFunction als auch direkt
 	#define ENABLED_IF( cond ) \
@@ -59,6 +120,19 @@ namespace Gui
         if( !( cond ) ) return; \
         /* else pass through */ \
     }
+    // Wie ENABLED_IF, aber cond ist ein mit new erzeugtes AsyncCondition, welches beim prepare im
+    // Hintergrund ausgewertet wird; für teure Bedingungen wie das Prüfen von Dateien.
+	#define ENABLED_IF_ASYNC( cond ) \
+    { \
+        Gui::UiFunction* f = Gui::UiFunction::me(); \
+        if( f && f->isPreparing() ) \
+        { \
+            f->prepareAsync( cond, Gui::UiFunction::Context::current()->d_target ); \
+            return; \
+        } \
+        if( !Gui::UiFunction::evaluate( cond ) ) return; \
+        /* else pass through */ \
+    }
     // 2014-05-04: folgende Funktion ruft neu gleich selber setCheckable auf, wodurch bei Menü unnötig
 	// NOTE: if(enabled) damit checked nur dann geprueft wird; sonst muss ueberall der Code auch noch auf Nullpointer gesichert werden
 	#define CHECKED_IF( enabled, checked ) \
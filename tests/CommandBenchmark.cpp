@@ -0,0 +1,226 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * GNU General Public License Usage
+ * This file may be used under the terms of the GNU General Public
+ * License (GPL) versions 2.0 or 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in
+ * the packaging of this file. Please review the following information
+ * to ensure GNU General Public Licensing requirements will be met:
+ * http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+ * http://www.gnu.org/copyleft/gpl.html.
+ */
+
+#include "CommandBenchmark.h"
+#include <GuiTools/AutoMenu.h>
+#include <GuiTools/AutoToolBar.h>
+#include <GuiTools/NamedFunction.h>
+#include <GuiTools/ShortcutDispatcher.h>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QtTest>
+#include <QStringList>
+#include <QFile>
+#include <QtDebug>
+#include <stdio.h>
+using namespace Gui;
+
+CommandBenchmark::CommandBenchmark(int depth, int width, int functions):
+    d_leaf(0),d_menu(0),d_toolBar(0),d_depth(qMax(depth,1)),d_width(qMax(width,1)),
+    d_functions(qMax(functions,1)),d_hits(0)
+{
+    build();
+}
+
+CommandBenchmark::~CommandBenchmark()
+{
+    setParent( 0 ); // sonst löscht uns d_root
+    delete d_root;
+}
+
+void CommandBenchmark::build()
+{
+    d_root = new QWidget();
+    d_root->resize( 400, 300 );
+    setParent( d_root ); // handleBench() wird erst bei der Wurzel gefunden
+
+    // Fokus-Kette der Tiefe d_depth; jede Ebene hat d_width - 1 Geschwister, welche
+    // NamedFunction::prepare ebenfalls nach dem Slot absucht.
+    QList<QWidget*> chain;
+    QWidget* cur = d_root;
+    for( int i = 0; i < d_depth; i++ )
+    {
+        QWidget* next = new QWidget( cur );
+        for( int j = 1; j < d_width; j++ )
+            new QWidget( cur );
+        chain.append( next );
+        cur = next;
+    }
+    d_leaf = cur;
+    d_leaf->setFocusPolicy( Qt::StrongFocus );
+
+    d_menu = new AutoMenu( d_root );
+    d_toolBar = new AutoToolBar( d_root );
+    for( int i = 0; i < d_functions; i++ )
+    {
+        const QString text = QString( "Command %1" ).arg( i );
+        d_menu->addAutoCommand( text, SLOT(handleBench()) );
+        d_toolBar->addAutoCommand( text, SLOT(handleBench()) );
+    }
+
+    // Viele dreistufige Folgen auf den Ebenen der Kette füllen den Trie, die gemessene Folge
+    // liegt bei der Wurzel, damit der Dispatcher die ganze Kette aufwärts gehen muss.
+    ShortcutDispatcher* d = ShortcutDispatcher::get( d_root );
+    NamedFunction* filler = new NamedFunction( "Filler", SLOT(handleBench()), this );
+    for( int i = 0; i < d_functions; i++ )
+    {
+        const QKeySequence s( Qt::ALT + Qt::Key_A + ( i / 26 ) % 26, Qt::Key_A + i % 26,
+                              Qt::Key_0 + ( i / 676 ) % 10 );
+        d->add( s, chain[ i % chain.size() ], filler );
+    }
+    d->add( QKeySequence( Qt::CTRL + Qt::SHIFT + Qt::Key_F12 ), d_root,
+            new NamedFunction( "Dispatch", SLOT(handleBench()), this ) );
+
+    d_root->show();
+    QApplication::setActiveWindow( d_root );
+    d_leaf->setFocus();
+    QApplication::processEvents();
+    if( QApplication::focusWidget() != d_leaf )
+        qWarning() << "CommandBenchmark: could not focus the leaf widget; results are not representative";
+}
+
+void CommandBenchmark::handleBench()
+{
+    ENABLED_IF( true );
+    d_hits++;
+}
+
+void CommandBenchmark::record(const char* name, int ops, qint64 nsecs, bool ok)
+{
+    Result r;
+    r.d_name = name;
+    r.d_ops = ops;
+    r.d_nsecs = nsecs;
+    r.d_ok = ok;
+    d_results.append( r );
+}
+
+void CommandBenchmark::runAll(int iterations)
+{
+    // Der Timer der Toolbar soll die Messungen nicht stören
+    const bool suspended = AutoToolBar::updatesSuspended();
+    AutoToolBar::setUpdatesSuspended( true );
+    benchPrepare( iterations );
+    benchMenuShow( iterations );
+    benchToolBarTick( iterations );
+    benchDispatch( iterations );
+    AutoToolBar::setUpdatesSuspended( suspended );
+}
+
+void CommandBenchmark::benchPrepare(int iterations)
+{
+    NamedFunction f( "Prepare", SLOT(handleBench()), this );
+    UiFunction* uf = &f; // prepareFor ist in NamedFunction protected
+    const int ops = iterations * d_functions;
+    QElapsedTimer t;
+    t.start();
+    for( int i = 0; i < ops; i++ )
+        uf->prepareFor( d_leaf );
+    record( "NamedFunction::prepare", ops, t.nsecsElapsed(), uf->isEnabled() );
+}
+
+void CommandBenchmark::benchMenuShow(int iterations)
+{
+    QElapsedTimer t;
+    t.start();
+    for( int i = 0; i < iterations; i++ )
+        QMetaObject::invokeMethod( d_menu, "aboutToShow" ); // ruft onShow ohne das Menü zu öffnen
+    const qint64 ns = t.nsecsElapsed();
+    record( "AutoMenu::onShow", iterations, ns, d_menu->actions().last()->isEnabled() );
+}
+
+void CommandBenchmark::benchToolBarTick(int iterations)
+{
+    QElapsedTimer t;
+    t.start();
+    for( int i = 0; i < iterations; i++ )
+        d_toolBar->prepareAll(); // entspricht einem timerEvent
+    const qint64 ns = t.nsecsElapsed();
+    record( "AutoToolBar::tick", iterations, ns, d_toolBar->actions().last()->isEnabled() );
+}
+
+void CommandBenchmark::benchDispatch(int iterations)
+{
+    const int ops = iterations * d_functions;
+    d_hits = 0;
+    QElapsedTimer t;
+    t.start();
+    // wie eine echte Taste, unter Qt5 inkl. ShortcutOverride
+    for( int i = 0; i < ops; i++ )
+        QTest::keyPress( d_leaf, Qt::Key_F12, Qt::ControlModifier | Qt::ShiftModifier );
+    const qint64 ns = t.nsecsElapsed();
+    record( "ShortcutDispatcher::dispatch", ops, ns, d_hits == ops );
+}
+
+QByteArray CommandBenchmark::toJson() const
+{
+    QByteArray out = "{\"config\":{\"depth\":" + QByteArray::number( d_depth ) +
+            ",\"width\":" + QByteArray::number( d_width ) +
+            ",\"functions\":" + QByteArray::number( d_functions ) + "},\"benchmarks\":[";
+    for( int i = 0; i < d_results.size(); i++ )
+    {
+        const Result& r = d_results[i];
+        if( i != 0 )
+            out += ',';
+        out += "\n{\"name\":\"" + r.d_name + "\",\"ops\":" + QByteArray::number( r.d_ops );
+        out += ",\"total_ns\":" + QByteArray::number( r.d_nsecs );
+        out += ",\"ns_per_op\":" + QByteArray::number( ( r.d_ops > 0 ) ? r.d_nsecs / r.d_ops : 0 );
+        out += ",\"ok\":" + QByteArray( ( r.d_ok ) ? "true" : "false" ) + "}";
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool CommandBenchmark::writeJson(const QString& path) const
+{
+    QFile f( path );
+    if( !f.open( QIODevice::WriteOnly ) )
+    {
+        qWarning() << "CommandBenchmark: cannot write" << path << f.errorString();
+        return false;
+    }
+    f.write( toJson() );
+    return true;
+}
+
+static int _intArg( const QStringList& args, const char* name, int def )
+{
+    const int i = args.indexOf( name );
+    if( i == -1 || i + 1 >= args.size() )
+        return def;
+    bool ok;
+    const int res = args[i+1].toInt( &ok );
+    return ( ok ) ? res : def;
+}
+
+int CommandBenchmark::exec()
+{
+    Q_ASSERT( qApp != 0 );
+    const QStringList args = QCoreApplication::arguments();
+    CommandBenchmark b( _intArg( args, "-depth", 20 ), _intArg( args, "-width", 5 ),
+                        _intArg( args, "-functions", 2000 ) );
+    b.runAll( _intArg( args, "-iterations", 10 ) );
+    const int o = args.indexOf( "-o" );
+    if( o != -1 && o + 1 < args.size() )
+        return ( b.writeJson( args[o+1] ) ) ? 0 : 1;
+    const QByteArray json = b.toJson();
+    fwrite( json.constData(), 1, json.size(), stdout );
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2000-2015 Rochus Keller <mailto:rkeller@nmr.ch>
+ *
+ * This file is part of the CARA (Computer Aided Resonance Assignment,
+ * see <http://cara.nmr.ch/>) NMR Application Framework (NAF) library.
+ *
+ * The following is the license that applies to this copy of the
+ * library. For a license to use the library under conditions
+ * other than those described here, please email to rkeller@nmr.ch.
+ *
+ * GNU General Public License Usage
+ * This file may be used under the terms of the GNU General Public
+ * License (GPL) versions 2.0 or 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in
+ * the packaging of this file. Please review the following information
+ * to ensure GNU General Public Licensing requirements will be met:
+ * http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+ * http://www.gnu.org/copyleft/gpl.html.
+ */
+
+#ifndef _Gui2_CommandBenchmark
+#define _Gui2_CommandBenchmark
+
+#include <QObject>
+#include <QPointer>
+#include <QList>
+#include <QByteArray>
+
+class QWidget;
+
+namespace Gui
+{
+	class AutoMenu;
+	class AutoToolBar;
+
+    // Misst die Kosten der Befehls-Infrastruktur auf einem synthetischen Widget-Baum: die Suche des
+    // Ziels von NamedFunction::prepare entlang der Fokus-Kette, AutoMenu::onShow auf grossen Menüs,
+    // einen AutoToolBar-Tick und die Auflösung eines Shortcuts im ShortcutDispatcher.
+    // Braucht eine QApplication; headless z.B. mit "-platform offscreen" (Qt5).
+    // Die Resultate werden als JSON ausgegeben, damit sie zwischen Commits verglichen werden können.
+	class CommandBenchmark : public QObject
+	{
+		Q_OBJECT
+	public:
+        struct Result
+        {
+            QByteArray d_name;
+            int d_ops; // Anzahl gemessene Operationen
+            qint64 d_nsecs; // total
+            bool d_ok; // false, wenn die Operation nicht das erwartete Resultat hatte
+        };
+
+        // depth: Tiefe der Fokus-Kette; width: Geschwister pro Ebene, welche prepare ebenfalls absucht;
+        // functions: Anzahl NamedFunctions in Menü und Toolbar bzw. Shortcuts im Dispatcher
+        CommandBenchmark( int depth = 20, int width = 5, int functions = 2000 );
+        ~CommandBenchmark();
+
+        void runAll( int iterations = 10 );
+        void benchPrepare( int iterations );
+        void benchMenuShow( int iterations );
+        void benchToolBarTick( int iterations );
+        void benchDispatch( int iterations );
+
+        const QList<Result>& results() const { return d_results; }
+        QByteArray toJson() const;
+        bool writeJson( const QString& path ) const;
+
+        // Für ein main(): wertet -depth, -width, -functions, -iterations und -o <path> in
+        // qApp->arguments() aus; ohne -o wird das JSON auf stdout geschrieben.
+        static int exec();
+	public slots:
+        void handleBench(); // Ziel aller NamedFunctions, nur bei der Wurzel auffindbar
+	protected:
+        void build();
+        void record( const char* name, int ops, qint64 nsecs, bool ok );
+	private:
+        QList<Result> d_results;
+        QPointer<QWidget> d_root;
+        QWidget* d_leaf;
+        AutoMenu* d_menu;
+        AutoToolBar* d_toolBar;
+        int d_depth, d_width, d_functions;
+        int d_hits;
+	};
+}
+
+#endif // _Gui2_CommandBenchmark
@@ -0,0 +1,21 @@
+# Benchmark der Befehls-Infrastruktur (AutoMenu, AutoToolBar, NamedFunction, ShortcutDispatcher);
+# Aufruf z.B. "CommandBenchmark -platform offscreen -o result.json"
+
+QT += core gui testlib
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = CommandBenchmark
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+include(../Menu.pri)
+
+SOURCES += \
+	CommandBenchmark.cpp \
+	main.cpp
+
+HEADERS += \
+	CommandBenchmark.h